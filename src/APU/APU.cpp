@@ -1,26 +1,27 @@
 #define MINIAUDIO_IMPLEMENTATION
 #include <MiniAudio/miniaudio.h>
-#include <GLFW/glfw3.h>
 
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 #include <thread>
 #include "APU.h"
 #include "../GBCore.h"
 #include "../Utils/bitOps.h"
  
 APU::APU(GBCore& gbCore) : gb(gbCore)
-{}
+{
+	for (auto& buffer : channelBuffers)
+		buffer.setRates(CPU_FREQUENCY, SAMPLE_RATE);
+}
 
 APU::~APU()
 {
 	if (soundDevice != nullptr)
 		ma_device_uninit(soundDevice.get());
-
-	if (isRecording)
-		stopRecording();
 }
 
-void APU::saveState(std::ostream& st) const
+void APU::saveState(StateWriter& st) const
 {
 	ST_WRITE(regs);
 	ST_WRITE(frameSequencerCycles);
@@ -29,9 +30,10 @@ void APU::saveState(std::ostream& st) const
 	ST_WRITE(channel2);
 	ST_WRITE(channel3.s); ST_WRITE(channel3.regs); ST_WRITE_ARR(channel3.waveRAM);
 	ST_WRITE(channel4);
+	ST_WRITE(subCycles); // States are taken after a sync, so there are no pending cycles.
 }
 
-void APU::loadState(std::istream& st)
+void APU::loadState(StateReader& st)
 {
 	ST_READ(regs);
 	ST_READ(frameSequencerCycles);
@@ -39,28 +41,50 @@ void APU::loadState(std::istream& st)
 	ST_READ(channel1);
 	ST_READ(channel2);
 	ST_READ(channel3.s); ST_READ(channel3.regs); ST_READ_ARR(channel3.waveRAM);
-	ST_READ(channel4); 
+	ST_READ(channel4);
+	ST_READ(subCycles);
+
+	pendingCycles = 0;
+	updateMixGains();
 }
 
-void APU::reset()
+void APU::initAudioDevice()
 {
-	if (soundDevice == nullptr)
-	{
+	if (soundDevice != nullptr)
+		return;
+
+	soundDevice = std::make_unique<ma_device>();
+
 #ifdef EMSCRIPTEN
-		initMiniAudio();
+	initMiniAudio();
 #else
-		std::thread t([this] { initMiniAudio(); }); // Because it can block main thread for a second or more.
-		t.detach();
+	std::thread t([this] { initMiniAudio(); }); // Because it can block main thread for a second or more.
+	t.detach();
 #endif
-	}
+}
 
+void APU::reset(bool clearOutput)
+{
 	regs.NR50 = 0x77;
 	regs.NR51 = 0xF3;
+	updateMixGains();
 	regs.apuEnable = true;
 
 	frameSequencerCycles = 0;
 	frameSequencerStep = 0;
 
+	subCycles = 0;
+	pendingCycles = 0;
+
+	if (clearOutput)
+	{
+		for (auto& buffer : channelBuffers)
+			buffer.clear();
+
+		channelOutputs = {};
+		frameTime = 0;
+	}
+
 	channel1.reset();
 	channel2.reset();
 	channel3.reset();
@@ -80,197 +104,197 @@ void sound_data_callback(ma_device* pDevice, void* pOutput, const void* pInput,
 	auto& apu { gb.apu };
 	auto* pOutput16 { static_cast<int16_t*>(pOutput) };
 
-	const bool mainThreadBlocked { APU::isMainThreadBlocked || ((glfwGetTime() - APU::lastMainThreadTime) > 0.1) };
-	const bool emulationStopped { gb.emulationPaused || gb.breakpointHit || !gb.executingProgram() || mainThreadBlocked };
+	const size_t sampleCount { frameCount * APU::CHANNELS };
 
-	if (!appConfig::enableAudio || emulationStopped || !apu.enabled())
+	if (!appConfig::enableAudio)
 	{
-		if (!emulationStopped && apu.enabled())
-			apu.execute(static_cast<int>(APU::CYCLES_PER_SAMPLE * frameCount));
-
-		std::memset(pOutput16, 0, sizeof(int16_t) * frameCount * APU::CHANNELS);
+		apu.sampleRing.clear();
+		std::memset(pOutput16, 0, sizeof(int16_t) * sampleCount);
 		return;
 	}
 
-	constexpr int WHOLE_CYCLES { static_cast<int>(APU::CYCLES_PER_SAMPLE) };
-	static double remainder { 0.0 };
+	// The ring simply runs dry when emulation is paused or the main thread is blocked.
+	const size_t readCount { apu.sampleRing.pop(pOutput16, sampleCount) };
 
-	for (ma_uint32 i = 0; i < frameCount; i++)
-	{
-		const int cycles { static_cast<int>(WHOLE_CYCLES + remainder) };
-		apu.execute(cycles);
-		remainder += APU::CYCLES_PER_SAMPLE - cycles;
+	// On underrun fade out from the last frame instead of dropping straight to zero, to avoid a click.
+	static std::array<int16_t, APU::CHANNELS> lastFrame{};
 
-		const auto samples { apu.generateSamples() };
+	if (readCount >= APU::CHANNELS)
+		std::memcpy(lastFrame.data(), &pOutput16[readCount - APU::CHANNELS], sizeof(lastFrame));
 
-		pOutput16[i * 2] = samples.first;
-		pOutput16[i * 2 + 1] = samples.second;
+	for (size_t i = readCount; i < sampleCount; i += APU::CHANNELS)
+	{
+		for (int ch = 0; ch < APU::CHANNELS; ch++)
+		{
+			lastFrame[ch] = static_cast<int16_t>(lastFrame[ch] * 31 / 32);
+			pOutput16[i + ch] = lastFrame[ch];
+		}
 	}
 
-	if (apu.isRecording)
-	{
-		const size_t bufferLen { apu.recordingBuffer.size() };
-		const size_t newBufferLen { bufferLen + (frameCount * APU::CHANNELS) };
+	apu.recorder.push(pOutput16, readCount);
+}
+
+void APU::initMiniAudio()
+{
+	ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
+	deviceConfig.playback.format = ma_format_s16;
+	deviceConfig.playback.channels = CHANNELS;
+	deviceConfig.sampleRate = SAMPLE_RATE;
+	deviceConfig.dataCallback = sound_data_callback;
+	deviceConfig.pUserData = &gb;
 
-		apu.recordingBuffer.resize(newBufferLen);
-		std::memcpy(&apu.recordingBuffer[bufferLen], pOutput16, sizeof(int16_t) * frameCount * APU::CHANNELS);
+	if (ma_device_init(NULL, &deviceConfig, soundDevice.get()) == MA_SUCCESS)
+		deviceRunning = ma_device_start(soundDevice.get()) == MA_SUCCESS;
+}
 
-		if (newBufferLen >= APU::SAMPLE_RATE)
-		{		
-			apu.recordingStream.write(reinterpret_cast<char*>(apu.recordingBuffer.data()), newBufferLen * sizeof(int16_t));
-			apu.recordingBuffer.clear();
-		}
+void APU::executeFrameSequencer()
+{
+	if ((frameSequencerStep & 1) == 0)
+	{
+		channel1.executeLength();
+		channel2.executeLength();
+		channel3.executeLength();
+		channel4.executeLength();
 
-		apu.recordedSeconds += (static_cast<float>(frameCount) / APU::SAMPLE_RATE);
+		if (frameSequencerStep == 2 || frameSequencerStep == 6)
+			channel1.executeSweep();
+	}
+	else if (frameSequencerStep == 7)
+	{
+		channel1.executeEnvelope();
+		channel2.executeEnvelope();
+		channel4.executeEnvelope();
 	}
+
+	frameSequencerCycles = 0;
+	frameSequencerStep = (frameSequencerStep + 1) & 7;
 }
 
-void APU::startRecording(const std::filesystem::path& filePath)
+void APU::executeChannels(uint32_t cycles)
 {
-	isRecording = true;
-	recordingStream = std::ofstream { filePath, std::ios::binary };
-	recordingBuffer.reserve(SAMPLE_RATE);
-	writeWAVHeader();
+	channel1.execute(cycles, [this](uint32_t t) { updateOutput(0, channel1.getSample(), frameTime + t); });
+	channel2.execute(cycles, [this](uint32_t t) { updateOutput(1, channel2.getSample(), frameTime + t); });
+	channel3.execute(cycles, [this](uint32_t t) { updateOutput(2, channel3.getSample(), frameTime + t); });
+	channel4.execute(cycles, [this](uint32_t t) { updateOutput(3, channel4.getSample(), frameTime + t); });
 }
 
-#define WRITE(val) recordingStream.write(reinterpret_cast<const char*>(&val), sizeof(val));
-
-void APU::writeWAVHeader()
+void APU::updateOutputs(uint32_t time)
 {
-	constexpr uint16_t BITS_PER_SAMPLE = sizeof(int16_t) * CHAR_BIT;
-	constexpr uint32_t BYTE_RATE = SAMPLE_RATE * sizeof(int16_t) * CHANNELS;
-	constexpr uint32_t SECTION_CHUNK_SIZE = 16;
-	constexpr uint16_t BLOCK_ALIGN = (BITS_PER_SAMPLE * CHANNELS) / CHAR_BIT;
-	constexpr uint16_t PCM_FORMAT = 1;
-
-	recordingStream.write("RIFF", 4);
-
-	uint32_t lengthReserve{};
-	WRITE(lengthReserve);
-	recordingStream.write("WAVE", 4);
-	recordingStream.write("fmt ", 4);
-
-	WRITE(SECTION_CHUNK_SIZE);
-	WRITE(PCM_FORMAT);
-	WRITE(CHANNELS);
-	WRITE(SAMPLE_RATE);
-	WRITE(BYTE_RATE);
-	WRITE(BLOCK_ALIGN);
-	WRITE(BITS_PER_SAMPLE);
-
-	recordingStream.write("data", 4);
-
-	uint32_t dataLengthReserve{};
-	WRITE(dataLengthReserve);
+	updateOutput(0, channel1.getSample(), time);
+	updateOutput(1, channel2.getSample(), time);
+	updateOutput(2, channel3.getSample(), time);
+	updateOutput(3, channel4.getSample(), time);
 }
 
-void APU::stopRecording()
+void APU::execute(uint32_t cycles)
 {
-	isRecording = false;
-	recordedSeconds = 0.f;
+	// Register writes since the last run take effect at its start.
+	updateOutputs(frameTime);
 
-	if (!recordingBuffer.empty())
+	while (cycles > 0)
 	{
-		recordingStream.write(reinterpret_cast<char*>(recordingBuffer.data()), recordingBuffer.size() * sizeof(int16_t));
-		recordingBuffer.clear();
-	}
+		uint32_t chunk { std::min(cycles, MAX_FRAME_CYCLES - frameTime) };
 
-	recordingStream.seekp(0, std::ios::end);
-	const uint32_t fileSize = static_cast<uint32_t>(recordingStream.tellp()) - 8;
+		if (regs.apuEnable)
+		{
+			// Channels jump straight from one waveform step to the next, frame sequencer events split the run.
+			chunk = std::min<uint32_t>(chunk, 2048 - frameSequencerCycles);
+			executeChannels(chunk);
+			frameSequencerCycles += chunk;
+
+			if (frameSequencerCycles == 2048)
+			{
+				executeFrameSequencer();
+				updateOutputs(frameTime + chunk);
+			}
+		}
 
-	recordingStream.seekp(4, std::ios::beg);
-	WRITE(fileSize);
+		frameTime += chunk;
+		cycles -= chunk;
 
-	const uint32_t dataSize = fileSize - 36; // Header is 44 bytes, 44 - 8 = 36.
-	recordingStream.seekp(40, std::ios::beg);
-	WRITE(dataSize);
+		if (frameTime == MAX_FRAME_CYCLES)
+			flushSamples();
+	}
 
-	recordingStream.close();
+	flushSamples();
 }
 
-#undef WRITE
-
-void APU::initMiniAudio()
+void APU::flushSamples()
 {
-	soundDevice = std::make_unique<ma_device>();
+	if (outputMuted)
+	{
+		frameTime = 0;
+		return;
+	}
 
-	ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
-	deviceConfig.playback.format = ma_format_s16;
-	deviceConfig.playback.channels = CHANNELS;
-	deviceConfig.sampleRate = SAMPLE_RATE;
-	deviceConfig.dataCallback = sound_data_callback;
-	deviceConfig.pUserData = &gb;
+	for (auto& buffer : channelBuffers)
+		buffer.endFrame(frameTime);
 
-	ma_device_init(NULL, &deviceConfig, soundDevice.get());
-	ma_device_start(soundDevice.get());
-}
+	frameTime = 0;
 
-void APU::executeFrameSequencer()
-{
-	frameSequencerCycles++;
+	const size_t count { channelBuffers[0].samplesAvailable() };
+	if (count == 0) return;
 
-	if (frameSequencerCycles == 2048)
-	{
-		if ((frameSequencerStep & 1) == 0)
-		{
-			channel1.executeLength();
-			channel2.executeLength();
-			channel3.executeLength();
-			channel4.executeLength();
+	std::array<std::array<int16_t, MAX_FRAME_SAMPLES>, 4> channelSamples;
 
-			if (frameSequencerStep == 2 || frameSequencerStep == 6)
-				channel1.executeSweep();
-		}
-		else if (frameSequencerStep == 7)
-		{
-			channel1.executeEnvelope();
-			channel2.executeEnvelope();
-			channel4.executeEnvelope();
-		}
+	for (int i = 0; i < 4; i++)
+		channelBuffers[i].readSamples(channelSamples[i].data(), count);
 
-		frameSequencerCycles = 0;
-		frameSequencerStep = (frameSequencerStep + 1) & 7;
+	if (channelSamplesCallback != nullptr)
+	{
+		channelSamplesCallback({ std::span<const int16_t> { channelSamples[0].data(), count }, std::span<const int16_t> { channelSamples[1].data(), count },
+								 std::span<const int16_t> { channelSamples[2].data(), count }, std::span<const int16_t> { channelSamples[3].data(), count } });
 	}
+
+	mixSamples(channelSamples, count);
+	updateResampleRate();
 }
 
-void APU::execute(int cycles)
+void APU::updateResampleRate()
 {
-	while (cycles--)
-	{
-		channel1.execute();
-		channel2.execute();
-		channel3.execute();
-		channel4.execute();
+	// Nudge the output rate slightly depending on how full the ring is, so it stays around the target fill level
+	// and the audio device clock drifting from emulation speed doesn't cause underruns or overflows. Small enough to not change pitch audibly.
+	constexpr double MAX_RATE_DELTA = 0.005;
+	double rate { SAMPLE_RATE };
 
-		executeFrameSequencer();
+	if (dynamicRateControl)
+	{
+		const double fill { static_cast<double>(bufferedFrames()) / TARGET_BUFFERED_FRAMES };
+		rate *= 1.0 + MAX_RATE_DELTA * std::clamp(1.0 - fill, -1.0, 1.0);
 	}
+
+	for (auto& buffer : channelBuffers)
+		buffer.setRates(CPU_FREQUENCY, rate);
 }
 
-std::pair<int16_t, int16_t> APU::generateSamples() 
+void APU::updateMixGains()
 {
-	float leftSample { 0.f }, rightSample { 0.f };
-	const uint8_t nr51 { regs.NR51.load() };
-
-	const float sample1 = (channel1.getSample() / 15.f) * enabledChannels[0], sample2 = (channel2.getSample() / 15.f) * enabledChannels[1],
-				sample3 = (channel3.getSample() / 15.f) * enabledChannels[2], sample4 = (channel4.getSample() / 15.f) * enabledChannels[3];
+	const uint8_t nr51 { regs.NR51 };
+	const uint8_t leftVolume = ((regs.NR50 & 0x70) >> 4) + 1, rightVolume = (regs.NR50 & 0x7) + 1;
 
-	leftSample += sample1 * getBit(nr51, 4);
-	rightSample += sample1 * getBit(nr51, 0);
+	// Full volume with all channels at max amplitude maps to INT16_MAX.
+	const double scaleFactor { (volume * INT16_MAX) / (4.0 * 15 * AMPLITUDE_SCALE) * (1 << StereoMixer::GAIN_BITS) };
+	const double leftScale { scaleFactor * (leftVolume / 8.0) }, rightScale { scaleFactor * (rightVolume / 8.0) };
 
-	leftSample += sample2 * getBit(nr51, 5);
-	rightSample += sample2 * getBit(nr51, 1);
+	StereoMixer::Gains leftGains{}, rightGains{};
 
-	leftSample += sample3 * getBit(nr51, 6);
-	rightSample += sample3 * getBit(nr51, 2);
+	for (int i = 0; i < 4; i++)
+	{
+		if (!enabledChannels[i])
+			continue;
 
-	leftSample += sample4 * getBit(nr51, 7);
-	rightSample += sample4 * getBit(nr51, 3);
+		leftGains[i] = static_cast<int16_t>(std::lround(leftScale * getBit(nr51, 4 + i)));
+		rightGains[i] = static_cast<int16_t>(std::lround(rightScale * getBit(nr51, i)));
+	}
 
-	const uint8_t leftVolume = ((regs.NR50 & 0x70) >> 4) + 1, rightVolume = (regs.NR50 & 0x7) + 1;
-	const float scaleFactor { (volume * INT16_MAX) / 4.0f };
+	mixer.setGains(leftGains, rightGains);
+}
 
-	leftSample *= scaleFactor * (leftVolume / 8.f);
-	rightSample *= scaleFactor * (rightVolume / 8.f);
+void APU::mixSamples(const std::array<std::array<int16_t, MAX_FRAME_SAMPLES>, 4>& channelSamples, size_t count)
+{
+	std::array<int16_t, MAX_FRAME_SAMPLES * CHANNELS> frames;
+	mixer.mix({ channelSamples[0].data(), channelSamples[1].data(), channelSamples[2].data(), channelSamples[3].data() }, frames.data(), count);
 
-	return std::make_pair(static_cast<int16_t>(leftSample), static_cast<int16_t>(rightSample));
-}
\ No newline at end of file
+	// If the ring is full (e.g. fast forward) the rest is simply dropped.
+	sampleRing.push(frames.data(), count * CHANNELS);
+}
@@ -1,20 +1,27 @@
 #pragma once
 #include <cstdint>
 #include <array>
+#include <algorithm>
 #include <vector>
 #include <filesystem>
 #include <fstream>
 #include <atomic>
+#include <span>
 
 #include "squareWave.h"
 #include "sweepWave.h"
 #include "customWave.h"
 #include "noiseWave.h"
+#include "blipBuffer.h"
+#include "stereoMixer.h"
+#include "audioRecorder.h"
+#include "../Utils/ringBuffer.h"
+#include "../Utils/stateStream.h"
 
 struct globalAPURegs
 {
-	std::atomic<uint8_t> NR50, NR51;
-	std::atomic<bool> apuEnable; // Instead of NR52, since it is the only writable bit.
+	uint8_t NR50, NR51;
+	bool apuEnable; // Instead of NR52, since it is the only writable bit.
 };
 
 class GBCore;
@@ -25,47 +32,121 @@ public:
 	friend class MMU;
 	friend GBCore;
 
-	void reset();
+	// Output buffers are kept when loading states, so audio continues without a click.
+	void reset(bool clearOutput = true);
+
+	// Audio output is started by the frontend, headless use (e.g. offline rendering) only reads the sample ring.
+	void initAudioDevice();
 
 	explicit APU(GBCore& gbCore);
 	~APU();
 
-	void execute(int cycles);
-	std::pair<int16_t, int16_t> generateSamples();
+	// Called every M-cycle from the emulation thread, APU runs at 1 MHz regardless of double speed mode.
+	// Cycles are only counted here, the APU itself runs lazily when synced.
+	inline void tick(uint8_t tCycles)
+	{
+		subCycles += tCycles;
+
+		if (subCycles >= 4)
+		{
+			subCycles -= 4;
+
+			if (++pendingCycles >= SYNC_CYCLES)
+				sync();
+		}
+	}
+
+	// Catches up the APU to the current cycle. Must be called before accessing audio registers.
+	inline void sync()
+	{
+		if (pendingCycles == 0)
+			return;
+
+		execute(pendingCycles);
+		pendingCycles = 0;
+	}
 
 	inline bool enabled() const { return regs.apuEnable; }
 
-	void saveState(std::ostream& st) const;
-	void loadState(std::istream& st);
+	void saveState(StateWriter& st) const;
+	void loadState(StateReader& st);
 
 	static constexpr uint32_t CPU_FREQUENCY = 1048576;
 	static constexpr uint32_t SAMPLE_RATE = 48000;
-	static constexpr double CYCLES_PER_SAMPLE = static_cast<double>(CPU_FREQUENCY) / SAMPLE_RATE;
 	static constexpr uint16_t CHANNELS = 2;
 
-	std::atomic<float> volume { 0.5 };
-	std::array<std::atomic<bool>, 4> enabledChannels { true, true, true, true };
+	// Interleaved stereo samples, produced by the emulation thread and consumed by the audio callback.
+	static constexpr size_t SAMPLE_RING_SIZE = 8192;
+	RingBuffer<int16_t, SAMPLE_RING_SIZE> sampleRing;
+
+	// Output latency to aim for, in stereo frames.
+	static constexpr size_t TARGET_BUFFERED_FRAMES = 2048;
+	inline size_t bufferedFrames() const { return sampleRing.size() / CHANNELS; }
+
+	std::atomic<bool> deviceRunning { false };
+
+	// Resample to keep the ring around target fill. Only makes sense when emulation is paced by a clock other than the audio device.
+	bool dynamicRateControl { false };
+
+	inline float getVolume() const { return volume; }
+	inline void setVolume(float newVolume) { volume = std::clamp(newVolume, 0.f, 1.f); updateMixGains(); }
 
-	std::atomic<bool> isRecording { false };
-	std::atomic<float> recordedSeconds { 0.f };
+	inline bool channelEnabled(int channel) const { return enabledChannels[channel]; }
+	inline void setChannelEnabled(int channel, bool enable) { enabledChannels[channel] = enable; updateMixGains(); }
 
-	static inline std::atomic<bool> isMainThreadBlocked { false };
-	static inline std::atomic<double> lastMainThreadTime { 0.0 };
+	// Channels still run while muted, but nothing reaches the output. Used for frames that get rolled back (run-ahead).
+	inline void setOutputMuted(bool muted) { outputMuted = muted; }
 
-	void startRecording(const std::filesystem::path& filePath);
-	void stopRecording();
+	// Must be called after NR50 or NR51 are written.
+	void updateMixGains();
 
-	std::ofstream recordingStream;
-	std::vector<int16_t> recordingBuffer;
+	// Band-limited output of each channel before panning and mixing, e.g. for exporting stems.
+	using ChannelSamples = std::array<std::span<const int16_t>, 4>;
+	inline void setChannelSamplesCallback(void (*callback)(const ChannelSamples&)) { channelSamplesCallback = callback; }
+
+	// Format is picked by extension, .flac or .wav.
+	inline bool startRecording(const std::filesystem::path& filePath) { return recorder.start(filePath, SAMPLE_RATE, CHANNELS); }
+	inline void stopRecording() { recorder.stop(); }
+
+	inline bool isRecording() const { return recorder.recording(); }
+	inline float recordedSeconds() const { return recorder.recordedSeconds(); }
+
+	AudioRecorder recorder;
 private:
+	static constexpr uint32_t SYNC_CYCLES = 1024;
+	static constexpr uint32_t MAX_FRAME_CYCLES = 4096;
+	static constexpr size_t MAX_FRAME_SAMPLES = (static_cast<uint64_t>(MAX_FRAME_CYCLES) * SAMPLE_RATE) / CPU_FREQUENCY + 1;
+
+	static constexpr int AMPLITUDE_SCALE = 1920; // Channel output (0-15) to band-limited buffer amplitude.
+
+	void execute(uint32_t cycles);
+	void executeChannels(uint32_t cycles);
 	void executeFrameSequencer();
+
+	inline void updateOutput(int channel, uint8_t sample, uint32_t time)
+	{
+		const int delta { sample - channelOutputs[channel] };
+		if (delta == 0 || outputMuted) return;
+
+		channelOutputs[channel] = sample;
+		channelBuffers[channel].addDelta(time, delta * AMPLITUDE_SCALE);
+	}
+	void updateOutputs(uint32_t time);
+
+	void flushSamples();
+	void updateResampleRate();
+	void mixSamples(const std::array<std::array<int16_t, MAX_FRAME_SAMPLES>, 4>& channelSamples, size_t count);
+
+	float volume { 0.5 };
+	std::array<bool, 4> enabledChannels { true, true, true, true };
+	StereoMixer mixer;
 	void initMiniAudio();
-	void writeWAVHeader();
 
 	typedef class ma_device ma_device;
 	std::unique_ptr<ma_device> soundDevice;
 
 	GBCore& gb;
+	void (*channelSamplesCallback)(const ChannelSamples&) { nullptr };
 
 	sweepWave channel1{};
 	squareWave<> channel2{};
@@ -97,4 +178,13 @@ private:
 
 	uint16_t frameSequencerCycles{};
 	uint8_t frameSequencerStep{};
+
+	uint8_t subCycles{};
+	uint32_t pendingCycles{};
+
+	std::array<BlipBuffer, 4> channelBuffers { BlipBuffer { MAX_FRAME_SAMPLES }, BlipBuffer { MAX_FRAME_SAMPLES },
+											   BlipBuffer { MAX_FRAME_SAMPLES }, BlipBuffer { MAX_FRAME_SAMPLES } };
+	std::array<uint8_t, 4> channelOutputs{};
+	uint32_t frameTime{}; // Cycles since the start of the current band-limited buffer frame.
+	bool outputMuted { false };
 };
\ No newline at end of file
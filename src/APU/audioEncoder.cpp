@@ -0,0 +1,74 @@
+#include <climits>
+#include <algorithm>
+#include <cctype>
+#include "audioEncoder.h"
+#include "flacEncoder.h"
+
+std::unique_ptr<AudioEncoder> AudioEncoder::create(const std::filesystem::path& path, uint32_t sampleRate, uint16_t channels)
+{
+	auto ext { path.extension().string() };
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+
+	std::unique_ptr<AudioEncoder> encoder;
+
+	if (ext == ".flac")
+		encoder = std::make_unique<FLACEncoder>(path, sampleRate, channels);
+	else
+		encoder = std::make_unique<WAVEncoder>(path, sampleRate, channels);
+
+	return encoder->st ? std::move(encoder) : nullptr;
+}
+
+#define WRITE(val) st.write(reinterpret_cast<const char*>(&val), sizeof(val));
+
+WAVEncoder::WAVEncoder(const std::filesystem::path& path, uint32_t sampleRate, uint16_t channels) : AudioEncoder(path, sampleRate, channels)
+{
+	const uint16_t BITS_PER_SAMPLE = sizeof(int16_t) * CHAR_BIT;
+	const uint32_t BYTE_RATE = sampleRate * sizeof(int16_t) * channels;
+	const uint32_t SECTION_CHUNK_SIZE = 16;
+	const uint16_t BLOCK_ALIGN = (BITS_PER_SAMPLE * channels) / CHAR_BIT;
+	const uint16_t PCM_FORMAT = 1;
+
+	st.write("RIFF", 4);
+
+	uint32_t lengthReserve{};
+	WRITE(lengthReserve);
+	st.write("WAVE", 4);
+	st.write("fmt ", 4);
+
+	WRITE(SECTION_CHUNK_SIZE);
+	WRITE(PCM_FORMAT);
+	WRITE(channels);
+	WRITE(sampleRate);
+	WRITE(BYTE_RATE);
+	WRITE(BLOCK_ALIGN);
+	WRITE(BITS_PER_SAMPLE);
+
+	st.write("data", 4);
+
+	uint32_t dataLengthReserve{};
+	WRITE(dataLengthReserve);
+}
+
+void WAVEncoder::write(const int16_t* samples, size_t frames)
+{
+	st.write(reinterpret_cast<const char*>(samples), frames * channels * sizeof(int16_t));
+	totalFrames += frames;
+}
+
+void WAVEncoder::finish()
+{
+	st.seekp(0, std::ios::end);
+	const uint32_t fileSize = static_cast<uint32_t>(st.tellp()) - 8;
+
+	st.seekp(4, std::ios::beg);
+	WRITE(fileSize);
+
+	const uint32_t dataSize = fileSize - 36; // Header is 44 bytes, 44 - 8 = 36.
+	st.seekp(40, std::ios::beg);
+	WRITE(dataSize);
+
+	st.close();
+}
+
+#undef WRITE
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+// Streams interleaved 16 bit PCM into an audio file.
+class AudioEncoder
+{
+public:
+	virtual ~AudioEncoder() = default;
+
+	// Picks the format by file extension (.flac, otherwise WAV). Returns nullptr if file couldn't be opened.
+	static std::unique_ptr<AudioEncoder> create(const std::filesystem::path& path, uint32_t sampleRate, uint16_t channels);
+
+	// Count is in frames (one sample for each channel).
+	virtual void write(const int16_t* samples, size_t frames) = 0;
+
+	// Flushes remaining data and finalizes the header. Encoder must not be written to after this.
+	virtual void finish() = 0;
+
+	inline uint64_t framesWritten() const { return totalFrames; }
+
+protected:
+	AudioEncoder(const std::filesystem::path& path, uint32_t sampleRate, uint16_t channels)
+		: st(path, std::ios::out | std::ios::binary), sampleRate(sampleRate), channels(channels)
+	{}
+
+	std::ofstream st;
+	uint32_t sampleRate;
+	uint16_t channels;
+	uint64_t totalFrames { 0 };
+};
+
+class WAVEncoder : public AudioEncoder
+{
+public:
+	WAVEncoder(const std::filesystem::path& path, uint32_t sampleRate, uint16_t channels);
+
+	void write(const int16_t* samples, size_t frames) override;
+	void finish() override;
+};
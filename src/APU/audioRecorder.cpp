@@ -0,0 +1,75 @@
+#include <array>
+#include <chrono>
+#include "audioRecorder.h"
+
+bool AudioRecorder::start(const std::filesystem::path& path, uint32_t rate, uint16_t channelCount)
+{
+	stop();
+
+	encoder = AudioEncoder::create(path, rate, channelCount);
+	if (encoder == nullptr) return false;
+
+	sampleRate = rate;
+	channels = channelCount;
+	framesWritten = 0;
+	stopRequested = false;
+
+#ifdef EMSCRIPTEN
+	queue.clear();
+	isRecording.store(true, std::memory_order_release);
+#else
+	// Clearing is a consumer side operation, so it's done on the writer thread. Audio thread doesn't push until recording is set.
+	writerThread = std::thread([this]
+	{
+		queue.clear();
+		isRecording.store(true, std::memory_order_release);
+		writerLoop();
+	});
+#endif
+	return true;
+}
+
+void AudioRecorder::stop()
+{
+	if (encoder == nullptr)
+		return;
+
+	stopRequested = true;
+
+	if (writerThread.joinable())
+		writerThread.join();
+
+	// After the join, so the writer thread can't set it again if recording is stopped right after it started.
+	isRecording.store(false, std::memory_order_release);
+	drain();
+	encoder->finish();
+	encoder.reset();
+}
+
+void AudioRecorder::writerLoop()
+{
+	using namespace std::chrono_literals;
+
+	while (!stopRequested)
+	{
+		drain();
+		std::this_thread::sleep_for(20ms);
+	}
+}
+
+void AudioRecorder::drain()
+{
+	std::array<int16_t, 4096> buffer;
+
+	while (true)
+	{
+		const size_t maxCount { buffer.size() - (buffer.size() % channels) };
+		const size_t count { queue.pop(buffer.data(), maxCount) };
+
+		const size_t frames { count / channels };
+		if (frames == 0) break;
+
+		encoder->write(buffer.data(), frames);
+		framesWritten.store(encoder->framesWritten(), std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <filesystem>
+
+#include "audioEncoder.h"
+#include "../Utils/ringBuffer.h"
+
+// Records audio from the real-time audio thread without doing any I/O on it.
+// Samples go through a preallocated lock-free queue, a writer thread encodes them to disk.
+class AudioRecorder
+{
+public:
+	~AudioRecorder() { stop(); }
+
+	bool start(const std::filesystem::path& path, uint32_t sampleRate, uint16_t channels);
+	void stop();
+
+	inline bool recording() const { return isRecording.load(std::memory_order_acquire); }
+	inline float recordedSeconds() const { return static_cast<float>(framesWritten.load(std::memory_order_relaxed)) / sampleRate; }
+
+	// Audio thread side, never blocks or allocates. Samples that don't fit are dropped.
+	inline void push(const int16_t* samples, size_t count)
+	{
+		if (!recording() || queue.freeSpace() < count)
+			return;
+
+		queue.push(samples, count);
+
+#ifdef EMSCRIPTEN
+		drain(); // No threads, but the audio callback runs on the main thread there anyway.
+#endif
+	}
+
+private:
+	// About 0.7 seconds of 48 kHz stereo audio.
+	static constexpr size_t QUEUE_SIZE = 1 << 16;
+
+	void writerLoop();
+	void drain();
+
+	RingBuffer<int16_t, QUEUE_SIZE> queue;
+	std::unique_ptr<AudioEncoder> encoder;
+
+	std::thread writerThread;
+	std::atomic<bool> isRecording { false };
+	std::atomic<bool> stopRequested { false };
+
+	std::atomic<uint64_t> framesWritten { 0 };
+	uint32_t sampleRate { 1 };
+	uint16_t channels { 1 };
+};
@@ -0,0 +1,91 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <numbers>
+#include "blipBuffer.h"
+
+namespace
+{
+	auto makeKernels()
+	{
+		// Windowed sinc (Blackman) impulse for each sub-sample phase, every phase sums to exactly 1 << DELTA_BITS
+		// so that integrating the buffer gives a band-limited step of the right height.
+		constexpr int WIDTH { BlipBuffer::KERNEL_WIDTH };
+		constexpr double CUTOFF { 0.45 }; // Relative to sample rate, slightly below nyquist.
+		constexpr double PI { std::numbers::pi };
+
+		std::array<std::array<int32_t, WIDTH>, BlipBuffer::PHASES> kernels{};
+
+		for (int phase = 0; phase < BlipBuffer::PHASES; phase++)
+		{
+			std::array<double, WIDTH> taps{};
+			double sum { 0.0 };
+
+			for (int i = 0; i < WIDTH; i++)
+			{
+				const double x { i - WIDTH / 2 + 1 - static_cast<double>(phase) / BlipBuffer::PHASES };
+				const double sinc { x == 0.0 ? 1.0 : std::sin(2 * PI * CUTOFF * x) / (2 * PI * CUTOFF * x) };
+
+				const double w { (x + WIDTH / 2.0) / WIDTH };
+				const double window { 0.42 - 0.5 * std::cos(2 * PI * w) + 0.08 * std::cos(4 * PI * w) };
+
+				taps[i] = sinc * window;
+				sum += taps[i];
+			}
+
+			int32_t total { 0 };
+
+			for (int i = 0; i < WIDTH; i++)
+			{
+				kernels[phase][i] = static_cast<int32_t>(std::lround(taps[i] / sum * (1 << BlipBuffer::DELTA_BITS)));
+				total += kernels[phase][i];
+			}
+
+			// Put rounding error into the center tap.
+			kernels[phase][WIDTH / 2 - 1] += (1 << BlipBuffer::DELTA_BITS) - total;
+		}
+
+		return kernels;
+	}
+}
+
+const std::array<std::array<int32_t, BlipBuffer::KERNEL_WIDTH>, BlipBuffer::PHASES> BlipBuffer::KERNELS { makeKernels() };
+
+BlipBuffer::BlipBuffer(size_t maxSamples) : buffer(maxSamples + KERNEL_WIDTH + 1)
+{}
+
+void BlipBuffer::setRates(double clockRate, double sampleRate)
+{
+	factor = static_cast<uint64_t>(std::ceil(sampleRate / clockRate * (1ULL << FRAC_BITS)));
+}
+
+void BlipBuffer::clear()
+{
+	offset = 0;
+	integrator = 0;
+	std::fill(buffer.begin(), buffer.end(), 0);
+}
+
+size_t BlipBuffer::readSamples(int16_t* out, size_t count)
+{
+	count = std::min(count, samplesAvailable());
+	int32_t sum { integrator };
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const int32_t sample { sum >> DELTA_BITS };
+		sum += buffer[i];
+		out[i] = static_cast<int16_t>(std::clamp<int32_t>(sample, INT16_MIN, INT16_MAX));
+		sum -= sample << (DELTA_BITS - BASS_SHIFT);
+	}
+
+	integrator = sum;
+
+	// Shift remaining deltas (including kernel tails past the end of the frame) to the start.
+	const size_t remaining { samplesAvailable() - count + KERNEL_WIDTH };
+	std::memmove(buffer.data(), &buffer[count], remaining * sizeof(int32_t));
+	std::fill_n(&buffer[remaining], count, 0);
+
+	offset -= static_cast<uint64_t>(count) << FRAC_BITS;
+	return count;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+
+// Band-limited step synthesis buffer (blip_buf style).
+// Amplitude changes are added as deltas at clock times, output samples are produced by integrating the buffer.
+class BlipBuffer
+{
+public:
+	static constexpr int KERNEL_WIDTH = 16;
+	static constexpr int PHASE_BITS = 6;
+	static constexpr int PHASES = 1 << PHASE_BITS;
+	static constexpr int DELTA_BITS = 15;
+
+	explicit BlipBuffer(size_t maxSamples);
+
+	// Ratio between clock and sample rate, can be changed at any time (e.g. for dynamic rate control).
+	void setRates(double clockRate, double sampleRate);
+	void clear();
+
+	inline void addDelta(uint32_t clockTime, int delta)
+	{
+		const uint64_t pos { offset + clockTime * factor };
+		const size_t index { static_cast<size_t>(pos >> FRAC_BITS) };
+		const int phase { static_cast<int>(pos >> (FRAC_BITS - PHASE_BITS)) & (PHASES - 1) };
+
+		const auto& kernel { KERNELS[phase] };
+		int32_t* out { &buffer[index] };
+
+		for (int i = 0; i < KERNEL_WIDTH; i++)
+			out[i] += kernel[i] * delta;
+	}
+
+	// Marks the end of the current time frame, samples up to it become available for reading.
+	inline void endFrame(uint32_t clockDuration) { offset += clockDuration * factor; }
+
+	inline size_t samplesAvailable() const { return static_cast<size_t>(offset >> FRAC_BITS); }
+
+	size_t readSamples(int16_t* out, size_t count);
+
+private:
+	static constexpr int FRAC_BITS = 32;
+	static constexpr int BASS_SHIFT = 9; // High pass filter to remove DC offset.
+
+	static const std::array<std::array<int32_t, KERNEL_WIDTH>, PHASES> KERNELS;
+
+	std::vector<int32_t> buffer;
+	uint64_t factor { 0 };
+	uint64_t offset { 0 };
+	int32_t integrator { 0 };
+};
@@ -2,13 +2,13 @@
 
 #include <array>
 #include <cstdint>
-#include <atomic>
 
+#include "frequencyTimer.h"
 #include "../defines.h"
 
 struct customWaveRegs
 {
-	std::atomic<uint8_t> NR30, NR31, NR32, NR33, NR34;
+	uint8_t NR30, NR31, NR32, NR33, NR34;
 };
 
 struct customWaveState
@@ -37,7 +37,9 @@ struct customWave
 		return regs.NR33 | ((regs.NR34 & 0b111) << 8);
 	}
 
-	inline bool dacEnabled() const { return getBit(regs.NR30.load(), 7); }
+	inline uint16_t getPeriod() const { return (2048 - getFrequency()) >> 1; }
+
+	inline bool dacEnabled() const { return getBit(regs.NR30, 7); }
 
 	inline uint8_t getVolumeShift() const
 	{
@@ -64,7 +66,7 @@ struct customWave
 
 	inline void executeLength()
 	{
-		if (!getBit(regs.NR34.load(), 6) || s.lengthTimer == 0) 
+		if (!getBit(regs.NR34, 6) || s.lengthTimer == 0) 
 			return;
 
 		s.lengthTimer--;
@@ -73,15 +75,34 @@ struct customWave
 			s.enabled = false;
 	}
 
-	inline void execute()
+	inline void advance(uint32_t cycles)
 	{
-		if (s.freqPeriodTimer == 0)
+		const uint32_t steps { advanceFrequencyTimer(s.freqPeriodTimer, getPeriod(), cycles) };
+		s.sampleInd = (s.sampleInd + steps) & 31;
+	}
+
+	template <typename F>
+	inline void execute(uint32_t cycles, F&& onStep)
+	{
+		// Output is silent regardless of wave position.
+		if (!s.enabled || getVolumeShift() == 4)
+		{
+			advance(cycles);
+			return;
+		}
+
+		const uint16_t reload { static_cast<uint16_t>(getPeriod() - 1) };
+		uint32_t elapsed { 0 };
+
+		while (cycles - elapsed > s.freqPeriodTimer)
 		{
-			s.freqPeriodTimer = (2048 - getFrequency()) >> 1;
+			elapsed += s.freqPeriodTimer + 1;
+			s.freqPeriodTimer = reload;
 			s.sampleInd = (s.sampleInd + 1) & 31;
+			onStep(elapsed);
 		}
 
-		s.freqPeriodTimer--;
+		s.freqPeriodTimer -= cycles - elapsed;
 	}
 
 	inline uint8_t getCurrentWaveByte() const
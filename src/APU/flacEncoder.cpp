@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <bit>
+#include "flacEncoder.h"
+
+namespace
+{
+	uint8_t crc8(const uint8_t* data, size_t len)
+	{
+		uint8_t crc { 0 };
+
+		for (size_t i = 0; i < len; i++)
+		{
+			crc ^= data[i];
+
+			for (int bit = 0; bit < 8; bit++)
+				crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+		}
+
+		return crc;
+	}
+
+	uint16_t crc16(const uint8_t* data, size_t len)
+	{
+		uint16_t crc { 0 };
+
+		for (size_t i = 0; i < len; i++)
+		{
+			crc ^= static_cast<uint16_t>(data[i] << 8);
+
+			for (int bit = 0; bit < 8; bit++)
+				crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : static_cast<uint16_t>(crc << 1);
+		}
+
+		return crc;
+	}
+
+	inline uint32_t zigzag(int32_t val) { return (static_cast<uint32_t>(val) << 1) ^ static_cast<uint32_t>(val >> 31); }
+
+	inline int32_t fixedResidual(const int32_t* x, int order)
+	{
+		switch (order)
+		{
+		case 0: return x[0];
+		case 1: return x[0] - x[-1];
+		case 2: return x[0] - 2 * x[-1] + x[-2];
+		case 3: return x[0] - 3 * x[-1] + 3 * x[-2] - x[-3];
+		case 4: return x[0] - 4 * x[-1] + 6 * x[-2] - 4 * x[-3] + x[-4];
+		default: return 0;
+		}
+	}
+
+	constexpr int MAX_RICE_PARAM = 14; // 15 is the escape code.
+
+	// Exact size in bits of a rice coded partition, and the parameter giving it.
+	std::pair<uint64_t, int> bestRiceParam(const uint32_t* residual, size_t count)
+	{
+		if (count == 0)
+			return { 0, 0 };
+
+		uint64_t sum { 0 };
+
+		for (size_t i = 0; i < count; i++)
+			sum += residual[i];
+
+		const uint64_t mean { sum / count };
+		const int estimate { mean == 0 ? 0 : std::min(static_cast<int>(std::bit_width(mean)) - 1, MAX_RICE_PARAM) };
+
+		std::pair<uint64_t, int> best { UINT64_MAX, 0 };
+
+		for (int param = std::max(estimate - 1, 0); param <= std::min(estimate + 1, MAX_RICE_PARAM); param++)
+		{
+			uint64_t bits { count * (param + 1ULL) };
+
+			for (size_t i = 0; i < count; i++)
+				bits += residual[i] >> param;
+
+			if (bits < best.first)
+				best = { bits, param };
+		}
+
+		return best;
+	}
+}
+
+void FLACEncoder::BitWriter::write(uint32_t val, int bitCount)
+{
+	if (bitCount == 0)
+		return;
+
+	acc = (acc << bitCount) | (bitCount == 32 ? val : (val & ((1U << bitCount) - 1)));
+	count += bitCount;
+
+	while (count >= 8)
+	{
+		count -= 8;
+		bytes.push_back(static_cast<uint8_t>(acc >> count));
+	}
+
+	acc &= (1ULL << count) - 1;
+}
+
+void FLACEncoder::BitWriter::writeUnary(uint32_t zeros)
+{
+	while (zeros >= 32)
+	{
+		write(0, 32);
+		zeros -= 32;
+	}
+
+	write(1, zeros + 1);
+}
+
+void FLACEncoder::BitWriter::writeRice(uint32_t val, int param)
+{
+	writeUnary(val >> param);
+	write(val, param);
+}
+
+void FLACEncoder::BitWriter::writeUTF8(uint64_t val)
+{
+	if (val < 0x80)
+	{
+		write(static_cast<uint32_t>(val), 8);
+		return;
+	}
+
+	int extraBytes { 1 };
+	while (extraBytes < 6 && val >= (1ULL << (6 + 5 * extraBytes)))
+		extraBytes++;
+
+	const uint32_t lead { (0xFF00U >> (extraBytes + 1)) & 0xFF };
+
+	write(lead | static_cast<uint32_t>(val >> (6 * extraBytes)), 8);
+
+	for (int i = extraBytes - 1; i >= 0; i--)
+		write(0x80 | static_cast<uint32_t>((val >> (6 * i)) & 0x3F), 8);
+}
+
+void FLACEncoder::BitWriter::align()
+{
+	if (count != 0)
+		write(0, 8 - count);
+}
+
+FLACEncoder::FLACEncoder(const std::filesystem::path& path, uint32_t sampleRate, uint16_t channels)
+	: AudioEncoder(path, sampleRate, channels), block(BLOCK_SIZE * channels)
+{
+	for (auto& data : channelData)
+		data.resize(BLOCK_SIZE);
+
+	residual.resize(BLOCK_SIZE);
+
+	st.write("fLaC", 4);
+	writeStreamInfo();
+}
+
+void FLACEncoder::writeStreamInfo()
+{
+	constexpr uint32_t STREAMINFO_LENGTH = 34;
+	BitWriter info;
+
+	info.write(1, 1); // Last metadata block
+	info.write(0, 7); // STREAMINFO
+	info.write(STREAMINFO_LENGTH, 24);
+
+	info.write(BLOCK_SIZE, 16); // Min block size (last block is allowed to be smaller)
+	info.write(BLOCK_SIZE, 16); // Max block size
+	info.write(minFrameSize == UINT32_MAX ? 0 : minFrameSize, 24);
+	info.write(maxFrameSize, 24);
+	info.write(sampleRate, 20);
+	info.write(channels - 1, 3);
+	info.write(BITS_PER_SAMPLE - 1, 5);
+	info.write(static_cast<uint32_t>(totalFrames >> 32), 4);
+	info.write(static_cast<uint32_t>(totalFrames), 32);
+
+	for (int i = 0; i < 4; i++)
+		info.write(0, 32); // MD5 signature, zero means not calculated.
+
+	st.write(reinterpret_cast<const char*>(info.bytes.data()), info.bytes.size());
+}
+
+void FLACEncoder::write(const int16_t* samples, size_t frames)
+{
+	totalFrames += frames;
+
+	while (frames > 0)
+	{
+		const uint32_t count { static_cast<uint32_t>(std::min<size_t>(frames, BLOCK_SIZE - blockFrames)) };
+		std::copy_n(samples, count * channels, &block[blockFrames * channels]);
+
+		blockFrames += count;
+		samples += count * channels;
+		frames -= count;
+
+		if (blockFrames == BLOCK_SIZE)
+			encodeFrame();
+	}
+}
+
+void FLACEncoder::finish()
+{
+	if (blockFrames > 0)
+		encodeFrame();
+
+	// Now that sizes and sample count are known.
+	st.seekp(4, std::ios::beg);
+	writeStreamInfo();
+	st.close();
+}
+
+uint64_t FLACEncoder::estimateCost(std::span<const int32_t> samples)
+{
+	uint64_t best { UINT64_MAX };
+
+	for (int order = 0; order <= MAX_FIXED_ORDER && order < static_cast<int>(samples.size()); order++)
+	{
+		uint64_t sum { 0 };
+
+		for (size_t i = order; i < samples.size(); i++)
+			sum += zigzag(fixedResidual(&samples[i], order));
+
+		best = std::min(best, sum);
+	}
+
+	return best;
+}
+
+void FLACEncoder::computeResidual(std::span<const int32_t> samples, int order, std::vector<uint32_t>& residual)
+{
+	for (size_t i = order; i < samples.size(); i++)
+		residual[i - order] = zigzag(fixedResidual(&samples[i], order));
+}
+
+void FLACEncoder::encodeFrame()
+{
+	const uint32_t blockSize { blockFrames };
+	bits.bytes.clear();
+
+	for (uint32_t ch = 0; ch < std::min<uint32_t>(channels, 2); ch++)
+	{
+		for (uint32_t i = 0; i < blockSize; i++)
+			channelData[ch][i] = block[i * channels + ch];
+	}
+
+	uint32_t channelAssignment { static_cast<uint32_t>(channels - 1) }; // Independent channels
+	std::array<std::pair<int, int>, 2> subframes { std::pair { 0, BITS_PER_SAMPLE }, std::pair { 1, BITS_PER_SAMPLE } }; // Channel data index and bits per sample
+
+	if (channels == 2)
+	{
+		auto& left { channelData[0] };
+		auto& right { channelData[1] };
+		auto& mid { channelData[2] };
+		auto& side { channelData[3] };
+
+		for (uint32_t i = 0; i < blockSize; i++)
+		{
+			mid[i] = (left[i] + right[i]) >> 1;
+			side[i] = left[i] - right[i];
+		}
+
+		const auto cost = [&](int ch) { return estimateCost({ channelData[ch].data(), blockSize }); };
+		const uint64_t leftCost { cost(0) }, rightCost { cost(1) }, midCost { cost(2) }, sideCost { cost(3) };
+
+		const std::array<uint64_t, 4> totals { leftCost + rightCost, leftCost + sideCost, sideCost + rightCost, midCost + sideCost };
+		const auto mode { std::distance(totals.begin(), std::min_element(totals.begin(), totals.end())) };
+
+		switch (mode)
+		{
+		case 1: channelAssignment = 0b1000; subframes = { std::pair { 0, BITS_PER_SAMPLE }, std::pair { 3, BITS_PER_SAMPLE + 1 } }; break;
+		case 2: channelAssignment = 0b1001; subframes = { std::pair { 3, BITS_PER_SAMPLE + 1 }, std::pair { 1, BITS_PER_SAMPLE } }; break;
+		case 3: channelAssignment = 0b1010; subframes = { std::pair { 2, BITS_PER_SAMPLE }, std::pair { 3, BITS_PER_SAMPLE + 1 } }; break;
+		default: break;
+		}
+	}
+
+	// Frame header
+	bits.write(0xFFF8, 16); // Sync code, fixed blocksize stream
+	bits.write(0b0111, 4); // Block size stored as 16 bit value at the end of the header
+	bits.write(0b0000, 4); // Sample rate from STREAMINFO
+	bits.write(channelAssignment, 4);
+	bits.write(0b100, 3); // 16 bits per sample
+	bits.write(0, 1);
+	bits.writeUTF8(frameNumber);
+	bits.write(blockSize - 1, 16);
+	bits.write(crc8(bits.bytes.data(), bits.bytes.size()), 8);
+
+	for (uint32_t ch = 0; ch < channels; ch++)
+	{
+		const auto [dataIndex, bps] { subframes[ch] };
+		encodeSubframe({ channelData[dataIndex].data(), blockSize }, bps);
+	}
+
+	bits.align();
+	const uint16_t crc { crc16(bits.bytes.data(), bits.bytes.size()) };
+	bits.write(crc, 16);
+
+	st.write(reinterpret_cast<const char*>(bits.bytes.data()), bits.bytes.size());
+
+	const uint32_t frameSize { static_cast<uint32_t>(bits.bytes.size()) };
+	minFrameSize = std::min(minFrameSize, frameSize);
+	maxFrameSize = std::max(maxFrameSize, frameSize);
+
+	frameNumber++;
+	blockFrames = 0;
+}
+
+void FLACEncoder::encodeSubframe(std::span<const int32_t> samples, int bps)
+{
+	const uint32_t blockSize { static_cast<uint32_t>(samples.size()) };
+
+	if (std::all_of(samples.begin(), samples.end(), [&](int32_t s) { return s == samples[0]; }))
+	{
+		bits.write(0, 1);
+		bits.write(0b000000, 6); // Constant
+		bits.write(0, 1);
+		bits.writeSigned(samples[0], bps);
+		return;
+	}
+
+	int bestOrder { 0 };
+	uint64_t bestSum { UINT64_MAX };
+
+	for (int order = 0; order <= MAX_FIXED_ORDER && order < static_cast<int>(blockSize); order++)
+	{
+		uint64_t sum { 0 };
+
+		for (uint32_t i = order; i < blockSize; i++)
+			sum += zigzag(fixedResidual(&samples[i], order));
+
+		if (sum < bestSum)
+		{
+			bestSum = sum;
+			bestOrder = order;
+		}
+	}
+
+	computeResidual(samples, bestOrder, residual);
+
+	// Fall back to verbatim if prediction doesn't help (e.g. noise). Rough estimate: rice codes take about log2(mean) + 2 bits.
+	const uint64_t residualCount { blockSize - static_cast<uint64_t>(bestOrder) };
+	const uint64_t mean { residualCount == 0 ? 0 : bestSum / residualCount };
+	const uint64_t estimatedBits { bestOrder * static_cast<uint64_t>(bps) + residualCount * (std::bit_width(mean) + 2) };
+
+	if (estimatedBits >= static_cast<uint64_t>(blockSize) * bps)
+	{
+		bits.write(0, 1);
+		bits.write(0b000001, 6); // Verbatim
+		bits.write(0, 1);
+
+		for (const int32_t sample : samples)
+			bits.writeSigned(sample, bps);
+
+		return;
+	}
+
+	bits.write(0, 1);
+	bits.write(0b001000 | bestOrder, 6); // Fixed predictor
+	bits.write(0, 1);
+
+	for (int i = 0; i < bestOrder; i++)
+		bits.writeSigned(samples[i], bps);
+
+	encodeResidual({ residual.data(), residualCount }, blockSize, bestOrder);
+}
+
+void FLACEncoder::encodeResidual(std::span<const uint32_t> values, uint32_t blockSize, int order)
+{
+	int bestPartitionOrder { 0 };
+	uint64_t bestBits { UINT64_MAX };
+	std::array<uint8_t, 1 << MAX_PARTITION_ORDER> bestParams{};
+
+	for (int partitionOrder = 0; partitionOrder <= MAX_PARTITION_ORDER; partitionOrder++)
+	{
+		const uint32_t partitionSize { blockSize >> partitionOrder };
+
+		if ((blockSize & ((1U << partitionOrder) - 1)) != 0 || partitionSize <= static_cast<uint32_t>(order))
+			break;
+
+		std::array<uint8_t, 1 << MAX_PARTITION_ORDER> params{};
+		uint64_t totalBits { 0 };
+		size_t offset { 0 };
+
+		for (uint32_t p = 0; p < (1U << partitionOrder); p++)
+		{
+			const size_t count { p == 0 ? partitionSize - order : partitionSize };
+			const auto [partitionBits, param] { bestRiceParam(&values[offset], count) };
+
+			params[p] = static_cast<uint8_t>(param);
+			totalBits += partitionBits + 4;
+			offset += count;
+		}
+
+		if (totalBits < bestBits)
+		{
+			bestBits = totalBits;
+			bestPartitionOrder = partitionOrder;
+			bestParams = params;
+		}
+	}
+
+	bits.write(0b00, 2); // Rice coding with 4 bit parameters
+	bits.write(bestPartitionOrder, 4);
+
+	const uint32_t partitionSize { blockSize >> bestPartitionOrder };
+	size_t offset { 0 };
+
+	for (uint32_t p = 0; p < (1U << bestPartitionOrder); p++)
+	{
+		const size_t count { p == 0 ? partitionSize - order : partitionSize };
+		bits.write(bestParams[p], 4);
+
+		for (size_t i = 0; i < count; i++)
+			bits.writeRice(values[offset + i], bestParams[p]);
+
+		offset += count;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <span>
+#include "audioEncoder.h"
+
+// Minimal lossless FLAC encoder: fixed blocksize, fixed polynomial predictors with partitioned rice coding
+// and stereo decorrelation. Compresses typical game audio to well under half of the PCM size.
+class FLACEncoder : public AudioEncoder
+{
+public:
+	FLACEncoder(const std::filesystem::path& path, uint32_t sampleRate, uint16_t channels);
+
+	void write(const int16_t* samples, size_t frames) override;
+	void finish() override;
+
+private:
+	static constexpr uint32_t BLOCK_SIZE = 4096;
+	static constexpr int MAX_FIXED_ORDER = 4;
+	static constexpr int MAX_PARTITION_ORDER = 6;
+	static constexpr int BITS_PER_SAMPLE = 16;
+
+	class BitWriter
+	{
+	public:
+		void write(uint32_t val, int bits);
+		void writeSigned(int32_t val, int bits) { write(static_cast<uint32_t>(val), bits); }
+		void writeUnary(uint32_t zeros);
+		void writeRice(uint32_t val, int param);
+		void writeUTF8(uint64_t val);
+		void align();
+
+		std::vector<uint8_t> bytes;
+	private:
+		uint64_t acc { 0 };
+		int count { 0 };
+	};
+
+	void writeStreamInfo();
+	void encodeFrame();
+	void encodeSubframe(std::span<const int32_t> samples, int bps);
+	void encodeResidual(std::span<const uint32_t> values, uint32_t blockSize, int order);
+
+	static uint64_t estimateCost(std::span<const int32_t> samples);
+	static void computeResidual(std::span<const int32_t> samples, int order, std::vector<uint32_t>& residual);
+
+	std::vector<int16_t> block;
+	uint32_t blockFrames { 0 };
+	uint64_t frameNumber { 0 };
+
+	uint32_t minFrameSize { UINT32_MAX };
+	uint32_t maxFrameSize { 0 };
+
+	BitWriter bits;
+	std::array<std::vector<int32_t>, 4> channelData; // Left, right, mid, side.
+	std::vector<uint32_t> residual;
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+// Advances a channel frequency timer by given cycles in one go. Same as decrementing it every cycle
+// and reloading it with the period on reaching zero. Returns the number of reloads (waveform steps).
+inline uint32_t advanceFrequencyTimer(uint16_t& timer, uint16_t period, uint32_t cycles)
+{
+	if (cycles <= timer)
+	{
+		timer -= cycles;
+		return 0;
+	}
+
+	const uint16_t reload { static_cast<uint16_t>(period - 1) }; // Period of 0 wraps around, like the per cycle timer did.
+	const uint32_t length { reload + 1u };
+
+	cycles -= timer + 1u;
+	timer = static_cast<uint16_t>(reload - (cycles % length));
+
+	return 1 + cycles / length;
+}
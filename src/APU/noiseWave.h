@@ -1,11 +1,14 @@
 #pragma once
 
 #include <cstdint>
-#include <atomic>
+#include <array>
+#include <algorithm>
+#include "frequencyTimer.h"
+#include "../Utils/bitOps.h"
 
 struct noiseWaveRegs
 {
-	std::atomic<uint8_t> NR41, NR42, NR43, NR44;
+	uint8_t NR41, NR42, NR43, NR44;
 };
 
 struct noiseWaveState
@@ -15,6 +18,44 @@ struct noiseWaveState
 	bool enabled { };
 };
 
+// Full LFSR sequences for both widths, to advance it by any number of steps with a single lookup.
+struct LFSRTables
+{
+	static constexpr uint16_t PERIOD_15 = 0x7FFF;
+	static constexpr uint16_t PERIOD_7 = 0x7F;
+
+	std::array<uint16_t, PERIOD_15> sequence15{};
+	std::array<uint16_t, PERIOD_15 + 1> index15{};
+
+	std::array<uint8_t, PERIOD_7> sequence7{};
+	std::array<uint8_t, PERIOD_7 + 1> index7{};
+
+	LFSRTables()
+	{
+		uint16_t lfsr { 0x7FFF };
+
+		for (uint16_t i = 0; i < PERIOD_15; i++)
+		{
+			sequence15[i] = lfsr;
+			index15[lfsr] = i;
+
+			const uint16_t xorResult = (lfsr & 0x1) ^ ((lfsr & 0x2) >> 1);
+			lfsr = (lfsr >> 1) | (xorResult << 14);
+		}
+
+		uint8_t lfsr7 { 0x7F };
+
+		for (uint8_t i = 0; i < PERIOD_7; i++)
+		{
+			sequence7[i] = lfsr7;
+			index7[lfsr7] = i;
+
+			const uint8_t xorResult = (lfsr7 & 0x1) ^ ((lfsr7 & 0x2) >> 1);
+			lfsr7 = (lfsr7 >> 1) | (xorResult << 6);
+		}
+	}
+};
+
 struct noiseWave
 {
 	inline void reset()
@@ -84,7 +125,7 @@ struct noiseWave
 
 	inline void executeLength()
 	{
-		if (!getBit(regs.NR44.load(), 6) || s.lengthTimer == 0)
+		if (!getBit(regs.NR44, 6) || s.lengthTimer == 0)
 			return;
 
 		s.lengthTimer--;
@@ -93,21 +134,76 @@ struct noiseWave
 			s.enabled = false;
 	}
 
-	inline void execute()
+	inline void stepLFSR()
+	{
+		const uint8_t xorResult = (s.LFSR & 0x1) ^ ((s.LFSR & 0x2) >> 1);
+		s.LFSR = (s.LFSR >> 1) | (xorResult << 14);
+
+		const bool smallWidthMode = getBit(regs.NR43, 3);
+
+		if (smallWidthMode)
+			s.LFSR = setBit(s.LFSR, 6, static_cast<bool>(xorResult));
+	}
+
+	void advanceLFSR(uint32_t steps)
+	{
+		if (steps == 0 || s.LFSR == 0)
+			return;
+
+		if (!getBit(regs.NR43, 3))
+		{
+			s.LFSR = lfsrTables.sequence15[(lfsrTables.index15[s.LFSR] + steps) % LFSRTables::PERIOD_15];
+			return;
+		}
+
+		// In 7 bit mode low 7 bits form their own LFSR and upper bits only hold the last 8 XOR results,
+		// so jump the low bits and run the last 8 steps normally to rebuild the rest.
+		// Low bits can be zero after switching from 15 bit mode, then they stay zero and the rest shifts out.
+		if (steps <= 8 || (s.LFSR & 0x7F) == 0)
+		{
+			for (uint32_t i = 0; i < std::min<uint32_t>(steps, 16); i++)
+				stepLFSR();
+
+			return;
+		}
+
+		const uint8_t low7 { lfsrTables.sequence7[(lfsrTables.index7[s.LFSR & 0x7F] + steps - 8) % LFSRTables::PERIOD_7] };
+		s.LFSR = (s.LFSR & ~0x7F) | low7;
+
+		for (int i = 0; i < 8; i++)
+			stepLFSR();
+	}
+
+	inline void advance(uint32_t cycles)
+	{
+		advanceLFSR(advanceFrequencyTimer(s.freqPeriodTimer, getPeriodTimer(), cycles));
+	}
+
+	template <typename F>
+	inline void execute(uint32_t cycles, F&& onStep)
 	{
-		if (s.freqPeriodTimer == 0)
+		if (s.amplitude == 0 || !s.enabled)
 		{
-			s.freqPeriodTimer = getPeriodTimer();
-			const uint8_t xorResult = (s.LFSR & 0x1) ^ ((s.LFSR & 0x2) >> 1);
-			s.LFSR = (s.LFSR >> 1) | (xorResult << 14);
+			advance(cycles);
+			return;
+		}
+
+		const uint16_t reload { static_cast<uint16_t>(getPeriodTimer() - 1) };
+		uint32_t elapsed { 0 };
 
-			const bool smallWidthMode = getBit(regs.NR43.load(), 3);
+		while (cycles - elapsed > s.freqPeriodTimer)
+		{
+			elapsed += s.freqPeriodTimer + 1;
+			s.freqPeriodTimer = reload;
 
-			if (smallWidthMode)
-				s.LFSR = setBit(s.LFSR, 6, static_cast<bool>(xorResult));
+			const bool oldOutput = s.LFSR & 0x1;
+			stepLFSR();
+
+			if ((s.LFSR & 0x1) != oldOutput)
+				onStep(elapsed);
 		}
 
-		s.freqPeriodTimer--;
+		s.freqPeriodTimer -= cycles - elapsed;
 	}
 
 	inline uint8_t getSample() const
@@ -116,6 +212,8 @@ struct noiseWave
 		return baseAmplitude * s.amplitude * s.enabled;
 	}
 
+	static inline const LFSRTables lfsrTables{};
+
 	noiseWaveState s{};
 	noiseWaveRegs regs{};
 };
\ No newline at end of file
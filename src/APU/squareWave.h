@@ -1,13 +1,13 @@
 #pragma once
 #include <cstdint>
 #include <array>
-#include <atomic>
 
+#include "frequencyTimer.h"
 #include "../Utils/bitOps.h"
 
 struct squareWaveRegs
 {
-	std::atomic<uint8_t> NRx1, NRx2, NRx3, NRx4;
+	uint8_t NRx1, NRx2, NRx3, NRx4;
 };
 
 struct squareWaveState
@@ -37,6 +37,8 @@ struct squareWave
 		return regs.NRx3 | ((regs.NRx4 & 0b111) << 8);
 	}
 
+	inline uint16_t getPeriod() const { return 2048 - getFrequency(); }
+
 	inline void disable() { s.enabled = false; }
 
 	inline void trigger()
@@ -80,7 +82,7 @@ struct squareWave
 
 	inline void executeLength()
 	{
-		if (!getBit(regs.NRx4.load(), 6) || s.lengthTimer == 0) 
+		if (!getBit(regs.NRx4, 6) || s.lengthTimer == 0) 
 			return;
 
 		s.lengthTimer--;
@@ -89,15 +91,42 @@ struct squareWave
 			s.enabled = false;
 	}
 
-	inline void execute()
+	inline void advance(uint32_t cycles)
+	{
+		const uint32_t steps { advanceFrequencyTimer(s.freqPeriodTimer, getPeriod(), cycles) };
+		s.dutyStep = (s.dutyStep + steps) & 7;
+	}
+
+	// Runs the frequency timer for given cycles, jumping straight to the steps where the output level changes.
+	// onStep is called with the cycle offset at which the new level takes effect.
+	template <typename F>
+	inline void execute(uint32_t cycles, F&& onStep)
 	{
-		if (s.freqPeriodTimer == 0)
+		if (s.amplitude == 0 || !s.enabled)
 		{
-			s.freqPeriodTimer = 2048 - getFrequency();
-			s.dutyStep = (s.dutyStep + 1) & 7;
+			advance(cycles);
+			return;
+		}
+
+		const uint8_t dutyType = regs.NRx1 >> 6;
+		const uint32_t period { getPeriod() };
+		uint32_t elapsed { 0 };
+
+		while (true)
+		{
+			const uint8_t steps { STEPS_TO_TOGGLE[dutyType][s.dutyStep] };
+			const uint32_t toggleTime { s.freqPeriodTimer + 1 + (steps - 1) * period };
+
+			if (cycles - elapsed < toggleTime)
+				break;
+
+			elapsed += toggleTime;
+			s.freqPeriodTimer = period - 1;
+			s.dutyStep = (s.dutyStep + steps) & 7;
+			onStep(elapsed);
 		}
 
-		s.freqPeriodTimer--;
+		advance(cycles - elapsed);
 	}
 
 	inline uint8_t getSample() const
@@ -114,6 +143,27 @@ struct squareWave
 		{ 1, 1, 1, 1, 1, 1, 0, 0 }
 	});
 
+	// Number of duty steps until the output level flips, for each duty type and step.
+	static constexpr auto STEPS_TO_TOGGLE = []
+	{
+		std::array<std::array<uint8_t, 8>, 4> table{};
+
+		for (int duty = 0; duty < 4; duty++)
+		{
+			for (int step = 0; step < 8; step++)
+			{
+				uint8_t steps { 1 };
+
+				while (DUTY_TABLE[duty][(step + steps) & 7] == DUTY_TABLE[duty][step])
+					steps++;
+
+				table[duty][step] = steps;
+			}
+		}
+
+		return table;
+	}();
+
 	state s{};
 	r regs{};
 };
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include "stereoMixer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIXER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MIXER_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+	// Round to nearest and saturate, same as the SIMD paths.
+	inline int16_t toSample(int32_t acc)
+	{
+		return static_cast<int16_t>(std::clamp((acc + (1 << (StereoMixer::GAIN_BITS - 1))) >> StereoMixer::GAIN_BITS, INT16_MIN, INT16_MAX));
+	}
+}
+
+void StereoMixer::mix(const std::array<const int16_t*, 4>& channels, int16_t* out, size_t count) const
+{
+	size_t i { 0 };
+
+#if defined(MIXER_SSE2)
+	// madd multiplies pairs of 16 bit values and adds the products, so channels are interleaved two by two
+	// and multiplied with matching gain pairs.
+	const auto gainPair = [](int16_t a, int16_t b) { return _mm_set1_epi32(static_cast<int32_t>(static_cast<uint16_t>(a)) | (static_cast<int32_t>(b) << 16)); };
+
+	const __m128i left01 { gainPair(leftGains[0], leftGains[1]) }, left23 { gainPair(leftGains[2], leftGains[3]) };
+	const __m128i right01 { gainPair(rightGains[0], rightGains[1]) }, right23 { gainPair(rightGains[2], rightGains[3]) };
+	const __m128i rounding { _mm_set1_epi32(1 << (GAIN_BITS - 1)) };
+
+	const auto scale = [&](__m128i acc) { return _mm_srai_epi32(_mm_add_epi32(acc, rounding), GAIN_BITS); };
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i ch0 { _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[0] + i)) };
+		const __m128i ch1 { _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[1] + i)) };
+		const __m128i ch2 { _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[2] + i)) };
+		const __m128i ch3 { _mm_loadu_si128(reinterpret_cast<const __m128i*>(channels[3] + i)) };
+
+		const __m128i ch01Lo { _mm_unpacklo_epi16(ch0, ch1) }, ch01Hi { _mm_unpackhi_epi16(ch0, ch1) };
+		const __m128i ch23Lo { _mm_unpacklo_epi16(ch2, ch3) }, ch23Hi { _mm_unpackhi_epi16(ch2, ch3) };
+
+		const __m128i leftLo { scale(_mm_add_epi32(_mm_madd_epi16(ch01Lo, left01), _mm_madd_epi16(ch23Lo, left23))) };
+		const __m128i leftHi { scale(_mm_add_epi32(_mm_madd_epi16(ch01Hi, left01), _mm_madd_epi16(ch23Hi, left23))) };
+		const __m128i rightLo { scale(_mm_add_epi32(_mm_madd_epi16(ch01Lo, right01), _mm_madd_epi16(ch23Lo, right23))) };
+		const __m128i rightHi { scale(_mm_add_epi32(_mm_madd_epi16(ch01Hi, right01), _mm_madd_epi16(ch23Hi, right23))) };
+
+		const __m128i left { _mm_packs_epi32(leftLo, leftHi) };
+		const __m128i right { _mm_packs_epi32(rightLo, rightHi) };
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), _mm_unpacklo_epi16(left, right));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2 + 8), _mm_unpackhi_epi16(left, right));
+	}
+#elif defined(MIXER_NEON)
+	const auto mixHalf = [](int16x4_t ch0, int16x4_t ch1, int16x4_t ch2, int16x4_t ch3, const Gains& gains)
+	{
+		int32x4_t acc { vmull_n_s16(ch0, gains[0]) };
+		acc = vmlal_n_s16(acc, ch1, gains[1]);
+		acc = vmlal_n_s16(acc, ch2, gains[2]);
+		acc = vmlal_n_s16(acc, ch3, gains[3]);
+		return vqrshrn_n_s32(acc, GAIN_BITS);
+	};
+
+	for (; i + 8 <= count; i += 8)
+	{
+		const int16x8_t ch0 { vld1q_s16(channels[0] + i) }, ch1 { vld1q_s16(channels[1] + i) };
+		const int16x8_t ch2 { vld1q_s16(channels[2] + i) }, ch3 { vld1q_s16(channels[3] + i) };
+
+		int16x8x2_t frames;
+		frames.val[0] = vcombine_s16(mixHalf(vget_low_s16(ch0), vget_low_s16(ch1), vget_low_s16(ch2), vget_low_s16(ch3), leftGains),
+									 mixHalf(vget_high_s16(ch0), vget_high_s16(ch1), vget_high_s16(ch2), vget_high_s16(ch3), leftGains));
+		frames.val[1] = vcombine_s16(mixHalf(vget_low_s16(ch0), vget_low_s16(ch1), vget_low_s16(ch2), vget_low_s16(ch3), rightGains),
+									 mixHalf(vget_high_s16(ch0), vget_high_s16(ch1), vget_high_s16(ch2), vget_high_s16(ch3), rightGains));
+
+		vst2q_s16(out + i * 2, frames);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		int32_t left { 0 }, right { 0 };
+
+		for (int ch = 0; ch < 4; ch++)
+		{
+			left += channels[ch][i] * leftGains[ch];
+			right += channels[ch][i] * rightGains[ch];
+		}
+
+		out[i * 2] = toSample(left);
+		out[i * 2 + 1] = toSample(right);
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+// Pans, scales and sums the four channel outputs into interleaved 16 bit stereo, 8 frames at a time where SIMD is available.
+// Gains are Q15 fixed point, set only when panning or volume changes.
+class StereoMixer
+{
+public:
+	static constexpr int GAIN_BITS = 15;
+	using Gains = std::array<int16_t, 4>;
+
+	inline void setGains(const Gains& left, const Gains& right)
+	{
+		leftGains = left;
+		rightGains = right;
+	}
+
+	void mix(const std::array<const int16_t*, 4>& channels, int16_t* out, size_t count) const;
+
+private:
+	Gains leftGains{};
+	Gains rightGains{};
+};
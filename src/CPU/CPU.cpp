@@ -18,13 +18,13 @@ void CPU::reset()
 	haltCycleCounter = 0;
 }
 
-void CPU::saveState(std::ostream& st) const
+void CPU::saveState(StateWriter& st) const
 {
 	ST_WRITE(s);
 	ST_WRITE(registers);
 }
 
-void CPU::loadState(std::istream& st)
+void CPU::loadState(StateReader& st)
 {
 	ST_READ(s);
 	ST_READ(registers);
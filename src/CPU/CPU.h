@@ -5,6 +5,7 @@
 #include <memory>
 #include "registers.h"
 #include "../Utils/bitOps.h"
+#include "../Utils/stateStream.h"
 
 enum class Interrupt : uint8_t
 {
@@ -47,9 +48,10 @@ public:
 
 	constexpr uint64_t haltCycleCount() const { return haltCycleCounter; }
 	constexpr void resetHaltCycleCount() { haltCycleCounter = 0; }
+	constexpr void setHaltCycleCount(uint64_t cycles) { haltCycleCounter = cycles; }
 
-	void saveState(std::ostream& st) const;
-	void loadState(std::istream& st);
+	void saveState(StateWriter& st) const;
+	void loadState(StateReader& st);
 private:
 	GBCore& gb;
 
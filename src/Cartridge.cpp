@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <bit>
 
 #include "Cartridge.h"
 #include "GBCore.h"
@@ -12,10 +13,11 @@
 #include "Mappers/HuC1.h"
 #include "Mappers/HuC3.h"
 
-Cartridge::Cartridge(GBCore& gbCore) : gb(gbCore), rom(std::vector<uint8_t>(MIN_ROM_SIZE * 2, 0xFF)), mapper(std::make_unique<RomOnlyMBC>(*this))
+Cartridge::Cartridge(GBCore& gbCore) : gb(gbCore), mapper(std::make_unique<RomOnlyMBC>(*this))
 {}
 
 uint64_t Cartridge::getGBCycles() const { return gb.cycleCount(); }
+void Cartridge::randomizeRAM() { gb.rng.fill(ram); }
 
 void Cartridge::unload()
 {
@@ -25,9 +27,7 @@ void Cartridge::unload()
 	romBanks = 2;
 	ramBanks = 0;
 
-	rom.resize(MIN_ROM_SIZE * 2);
-	std::memset(rom.data(), 0xFF, MIN_ROM_SIZE * 2);
-	rom.shrink_to_fit();
+	rom = {}; // Empty image reads as 0xFF.
 
 	ram.clear();
 	ram.shrink_to_fit();
@@ -48,35 +48,17 @@ bool Cartridge::loadROM(std::istream& st)
 	if (!processCartridgeHeader(st))
 		return false;
 
-	// 16 KB
-	if (size == MIN_ROM_SIZE)
-	{
-		// Pad to 32 KB
-		rom.resize(MIN_ROM_SIZE * 2);
-		std::memset(rom.data() + MIN_ROM_SIZE, 0xFF, MIN_ROM_SIZE);
-	}
-	else
-	{
-		// If rom size is not power of 2, pad to the next one.
-		if ((size & (size - 1)) != 0)
-		{
-			uint32_t newSize { 1 };
-
-			while (newSize < size)
-				newSize <<= 1;
-
-			rom.resize(newSize);
-			std::memset(rom.data() + size, 0xFF, (newSize - size));
-		}
-		else
-			rom.resize(size);
-	}
+	std::vector<uint8_t> data(size);
+	st.seekg(0, std::ios::beg);
+	st.read(reinterpret_cast<char*>(data.data()), size);
+
+	if (!st)
+		return false;
 
-	this->romBanks = rom.size() / romBankSize();
+	rom = RomImage::share(std::move(data));
 
-	rom.shrink_to_fit();
-	st.seekg(0, std::ios::beg);
-	st.read(reinterpret_cast<char*>(rom.data()), size);
+	// At least 32 KB, and if rom size is not power of 2 the next one. The padding isn't stored, bank mask covers it and RomImage reads it as 0xFF.
+	this->romBanks = std::bit_ceil(std::max(size, MIN_ROM_SIZE * 2)) / romBankSize();
 
 	romLoaded = true;
 	return true;
@@ -5,6 +5,7 @@
 
 #include "Mappers/MBCBase.h"
 #include "Mappers/RTC.h"
+#include "romImage.h"
 #include "Utils/bitOps.h"
 #include "appConfig.h"
 #include "gbSystem.h"
@@ -36,6 +37,7 @@ public:
 	constexpr uint8_t getChecksum() const { return checksum; }
 
 	uint64_t getGBCycles() const;
+	void randomizeRAM();
 
 	bool hasRAM { false };
 	bool hasBattery { false };
@@ -45,7 +47,7 @@ public:
 
 	RTC* rtc { nullptr };
 
-	std::vector<uint8_t> rom{};
+	RomImage rom{};
 	std::vector<uint8_t> ram{};
 
 	bool loadROM(std::istream& st);
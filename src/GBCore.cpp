@@ -1,11 +1,14 @@
 ﻿#include <fstream>
 #include <string>
+#include <sstream>
+#include <cstring>
 #include <miniz/miniz.h>
 
 #include "GBCore.h"
 #include "appConfig.h"
 #include "Utils/fileUtils.h"
 #include "Utils/memstream.h"
+#include "Utils/hashOps.h"
 #include "debugUI.h"
 
 GBCore::GBCore()
@@ -28,17 +31,18 @@ void GBCore::updatePPUSystem()
 	switch (System::Current())
 	{
 	case GBSystem::DMG:
-		ppu = std::unique_ptr<PPU> { std::make_unique<PPUCore<GBSystem::DMG>>(mmu, cpu) };
+		ppu = std::unique_ptr<PPU> { std::make_unique<PPUCore<GBSystem::DMG>>(mmu, cpu, rng) };
 		break;
 	case GBSystem::CGB:
-		ppu = std::unique_ptr<PPU> { std::make_unique<PPUCore<GBSystem::CGB>>(mmu, cpu) };
+		ppu = std::unique_ptr<PPU> { std::make_unique<PPUCore<GBSystem::CGB>>(mmu, cpu, rng) };
 		break;
 	case GBSystem::DMGCompatMode:
-		ppu = std::unique_ptr<PPU> { std::make_unique<PPUCore<GBSystem::DMGCompatMode>>(mmu, cpu) };
+		ppu = std::unique_ptr<PPU> { std::make_unique<PPUCore<GBSystem::DMGCompatMode>>(mmu, cpu, rng) };
 		break;
 	}
 
 	ppu->setDebugEnable(ppuDebugEnable);
+	ppu->setFramebufferFormat(framebufferFormat);
 
 	ppu->drawCallback = [&](const uint8_t* framebuf, bool firstFrame) 
 	{
@@ -48,12 +52,18 @@ void GBCore::updatePPUSystem()
 				mmu.write8(cheat.addr, cheat.newData);
 		}
 
-		if (this->drawCallback != nullptr)
+		if (this->drawCallback != nullptr && presentFrames && !ppu->frameRenderSkipped())
+		{
+			// The frame presented before this one was a speculative one, so the changed lines can't be trusted.
+			if (runAheadFrames != 0)
+				ppu->markFramebufferChanged();
+
 			this->drawCallback(framebuf, firstFrame);
+		}
 	};
 }
 
-void GBCore::reset(bool resetBattery, bool clearBuf, bool fullReset)
+void GBCore::reset(bool resetBattery, bool clearBuf, bool fullReset, bool randomizeRAM)
 {
 	if (fullReset)
 	{
@@ -72,12 +82,14 @@ void GBCore::reset(bool resetBattery, bool clearBuf, bool fullReset)
 			updateSystem();
 	}
 
-	ppu->reset(clearBuf);
+	cycleCounter = 0; // Before the components, a pinned RTC clock is based on it.
+
+	ppu->reset(clearBuf, randomizeRAM);
 	cpu.reset();
-	mmu.reset();
+	mmu.reset(randomizeRAM);
 	serial.reset();
 	joypad.reset();
-	apu.reset();
+	apu.reset(clearBuf);
 	cartridge.getMapper()->reset(resetBattery);
 
 	if (mmu.isBootROMMapped)
@@ -90,7 +102,6 @@ void GBCore::reset(bool resetBattery, bool clearBuf, bool fullReset)
 
 	emulationPaused = false;
 	breakpointHit = false;
-	cycleCounter = 0;
 	frameCounter = 0;
 	cpuUsageCycles = 0;
 	cpuUsage = 0.f;
@@ -146,13 +157,19 @@ void GBCore::enableDMGCompatMode()
 {
 	System::Set(GBSystem::DMGCompatMode);
 
-	std::stringstream st;
-	ppu->saveState(st); // Need to save ppu state, since ppu object is destroyed when changing the system.
+	// Need to save ppu state, since ppu object is destroyed when changing the system.
+	StateWriter sizeCounter;
+	ppu->saveState(sizeCounter);
+
+	std::vector<uint8_t> ppuState(sizeCounter.size());
+	StateWriter writer { ppuState };
+	ppu->saveState(writer);
 
 	updatePPUSystem();
 	mmu.updateSystem();
 
-	ppu->loadState(st);
+	StateReader reader { ppuState };
+	ppu->loadState(reader);
 
 	// CGB boot rom doesn't do that for some reason but keeps it at 0x7F which is incorrect for DMG mode, maybe it happens implicitly on KEY0 write??
 	serial.writeSerialControl(0x7E);
@@ -179,15 +196,54 @@ bool GBCore::runNoCartridgeBootROM(GBSystem bootSys)
 template void GBCore::emulateFrameBase<true>();
 template void GBCore::emulateFrameBase<false>();
 
-template <bool checkBreakpoints>
-void GBCore::emulateFrameBase()
+void GBCore::emulateFrameRunAhead()
 {
-	if (!executingProgram() || emulationPaused) [[unlikely]]
+	if (emulationPaused) [[unlikely]]
 		return;
 
-	const uint32_t frameCycles { CYCLES_PER_FRAME * speedFactor };
-	const uint64_t targetCycles { cycleCounter + frameCycles };
+	// Real frame: its audio is output, but the picture isn't presented.
+	presentFrames = false;
+	emulateFrameBase<false>();
 
+	if (runAheadState.empty())
+		runAheadState.resize(captureState({}));
+
+	const size_t stateSize { captureState(runAheadState) };
+
+	if (stateSize > runAheadState.size())
+	{
+		runAheadState.resize(stateSize);
+		captureState(runAheadState);
+	}
+
+	const auto prevFrameCounter { frameCounter };
+	const auto prevCPUUsageCycles { cpuUsageCycles };
+	const auto prevHaltCycles { cpu.haltCycleCount() };
+	const auto prevCPUUsage { cpuUsage };
+
+	// Speculative frames: only the last one is presented, and no audio is output for them.
+	apu.setOutputMuted(true);
+
+	for (int i = 0; i < runAheadFrames; i++)
+	{
+		presentFrames = i == runAheadFrames - 1;
+		emulateFrameBase<false>();
+	}
+
+	presentFrames = true;
+	apu.setOutputMuted(false);
+
+	restoreState({ runAheadState.data(), stateSize });
+
+	frameCounter = prevFrameCounter;
+	cpuUsageCycles = prevCPUUsageCycles;
+	cpu.setHaltCycleCount(prevHaltCycles);
+	cpuUsage = prevCPUUsage;
+}
+
+template <bool checkBreakpoints>
+bool GBCore::runUntil(uint64_t targetCycles)
+{
 	while (cycleCounter < targetCycles)
 	{
 		if constexpr (checkBreakpoints)
@@ -199,12 +255,48 @@ void GBCore::emulateFrameBase()
 			}
 
 			if (breakpointHit) [[unlikely]]
-				break;
+				return false;
 		}
 
 		cycleCounter += cpu.execute();
 	}
 
+	return true;
+}
+
+template <bool checkBreakpoints>
+void GBCore::emulateFrameBase()
+{
+	if (!executingProgram() || emulationPaused) [[unlikely]]
+		return;
+
+	const uint32_t frameCycles { CYCLES_PER_FRAME * speedFactor };
+	const uint64_t targetCycles { cycleCounter + frameCycles };
+
+	if (speedFactor > 1) [[unlikely]]
+	{
+		// Only the frame which reaches vblank last gets presented, so skip rendering of all frames started before or after it.
+		constexpr uint32_t VBLANK_START_CYCLES { PPU::SCR_HEIGHT * 456 };
+		const uint64_t renderEnd { targetCycles - VBLANK_START_CYCLES };
+		const uint64_t renderStart { renderEnd - CYCLES_PER_FRAME };
+
+		ppu->setRenderSkip(true);
+		bool running { runUntil<checkBreakpoints>(renderStart) };
+
+		ppu->setRenderSkip(false);
+		running = running && runUntil<checkBreakpoints>(renderEnd);
+
+		ppu->setRenderSkip(true);
+		if (running) runUntil<checkBreakpoints>(targetCycles);
+	}
+	else
+	{
+		ppu->setRenderSkip(false);
+		runUntil<checkBreakpoints>(targetCycles);
+	}
+
+	apu.sync();
+
 	cpuUsageCycles += frameCycles;
 
 	if (++frameCounter % 60 == 0)
@@ -219,6 +311,7 @@ void GBCore::stepComponents()
 {
 	cpu.executeTimer();
 	ppu->execute();
+	apu.tick(cpu.TcyclesPerM());
 	mmu.execute();
 	serial.execute();
 }
@@ -236,6 +329,8 @@ FileLoadResult GBCore::loadFile(std::istream& st, std::filesystem::path filePath
 		return FileLoadResult::FileError;
 
 	autoSave();
+	fileWriter.flush();
+
 	const bool isSaveState { isSaveStateFile(st) };
 
 	if (isSaveState)
@@ -282,6 +377,7 @@ FileLoadResult GBCore::loadFile(std::istream& st, std::filesystem::path filePath
 						{
 							backupBatteryFile();
 							cartridge.getMapper()->loadBattery(st);
+							discardBatteryFileState();
 						}
 
 						romLoaded = true;
@@ -298,6 +394,8 @@ FileLoadResult GBCore::loadFile(std::istream& st, std::filesystem::path filePath
 				if (!cartridge.getMapper()->loadBattery(st))
 					return FileLoadResult::InvalidBattery;
 
+				discardBatteryFileState();
+
 				currentSave = 0;
 				reset(false);
 			}
@@ -332,6 +430,7 @@ bool GBCore::loadROM(std::istream& st, const std::filesystem::path& filePath)
 
 	currentSave = 0;
 	romFilePath = filePath;
+	applyClockPin();
 	reset(true);
 
 	if (speedFactor != 1 && cartridge.rtc != nullptr)
@@ -394,7 +493,7 @@ std::vector<uint8_t> GBCore::extractZippedROM(std::istream& st)
 void GBCore::autoSave() const 
 {
 	if (currentSave != 0 && appConfig::autosaveState)
-		saveState(getSaveStatePath(currentSave));
+		queueStateWrite(getSaveStatePath(currentSave), currentSave, StateCodec::LZ4, false);
 
 	if (!cartridge.hasBattery || !appConfig::batterySaves) 
 		return;
@@ -404,7 +503,30 @@ void GBCore::autoSave() const
 
 	if (cartridge.getMapper()->sramDirty)
 	{
-		saveBattery(getBatteryFilePath());
+		std::ostringstream st;
+		saveBattery(st);
+		auto battery { std::move(st).str() };
+
+		if (appConfig::incrementalBatterySaves)
+		{
+			// Only the pages the game wrote to since the last save are written. After a failed write, the next one rewrites the whole file.
+			const std::span batteryData { reinterpret_cast<const uint8_t*>(battery.data()), battery.size() };
+			auto update { batteryFile.makeUpdate(getBatteryFilePath(), batteryData) };
+
+			if (!update.empty())
+				fileWriter.submitTask([update = std::move(update)] { return IncrementalFile::write(update); });
+		}
+		else
+		{
+			batteryFile.invalidate();
+
+			// Also removes a journal left by incremental writes, which would otherwise be recovered over this save.
+			fileWriter.submitTask([path = getBatteryFilePath(), battery = std::move(battery)]
+			{
+				return IncrementalFile::writeFull(path, { reinterpret_cast<const uint8_t*>(battery.data()), battery.size() });
+			});
+		}
+
 		cartridge.getMapper()->sramDirty = false;
 	}
 }
@@ -414,6 +536,8 @@ void GBCore::backupBatteryFile() const
 	if (!cartridge.hasBattery || !appConfig::batterySaves || !customBatterySavePath.empty())
 		return;
 	
+	fileWriter.flush();
+
 	const auto batterySavePath { getBatteryFilePath() };
 	auto batteryBackupPath { FileUtils::replaceExtension(batterySavePath, ".sav.bak") };
 	std::error_code err;
@@ -426,6 +550,7 @@ void GBCore::backupBatteryFile() const
 
 FileLoadResult GBCore::loadState(const std::filesystem::path& path)
 {
+	fileWriter.flush(); // State may have just been saved.
 	std::ifstream st { path, std::ios::in | std::ios::binary };
 
 	if (!st) 
@@ -446,86 +571,109 @@ FileLoadResult GBCore::loadState(int num)
 	return result;
 }
 
-void GBCore::saveState(const std::filesystem::path& path) const
+void GBCore::saveState(const std::filesystem::path& path, StateCodec codec) const
 {
-	if (!canSaveStateNow())
-		return;
-
-	std::error_code err;
-
-	if (!std::filesystem::exists(saveStateFolderPath, err))
-		std::filesystem::create_directories(saveStateFolderPath, err);
-
-	std::ofstream st { path, std::ios::out | std::ios::binary };
-	if (!st) return;
-	writeState(st);
+	queueStateWrite(path, 0, codec);
 }
 void GBCore::saveState(int num)
 {
 	if (!canSaveStateNow())
 		return;
 
-	saveState(getSaveStatePath(num));
+	queueStateWrite(getSaveStatePath(num), num, StateCodec::LZ4);
 
 	if (currentSave == 0)
 		updateSelectedSaveInfo(num);
 }
 
-uint64_t GBCore::calculateHash(std::span<const uint8_t> data)
+uint64_t GBCore::calculateHash(std::span<const uint8_t> data, uint16_t saveStateVersion)
 {
-	constexpr uint64_t FNV_PRIME = 0x100000001b3;
-	uint64_t hash { 0xcbf29ce484222325 };
+	return saveStateVersion < XXHASH_SAVE_STATE_VERSION ? HashOps::fnv1a(data) : HashOps::xxHash64(data);
+}
 
-	for (const auto byte : data)
+namespace
+{
+	constexpr uint32_t makeChunkTag(std::string_view name)
 	{
-		hash ^= byte;
-		hash *= FNV_PRIME;
+		return static_cast<uint32_t>(name[0]) | (static_cast<uint32_t>(name[1]) << 8) | (static_cast<uint32_t>(name[2]) << 16) | (static_cast<uint32_t>(name[3]) << 24);
 	}
 
-	return hash;
+	constexpr uint32_t INFO_CHUNK = makeChunkTag("INFO");
+	constexpr uint32_t THUMBNAIL_CHUNK = makeChunkTag("THMB");
+	constexpr uint32_t LEGACY_STATE_CHUNK = makeChunkTag("GBST"); // Never written, holds the single state block of files from before chunks.
+
+	constexpr size_t CHUNK_HEADER_SIZE = sizeof(uint32_t) + sizeof(StateCodec) + sizeof(uint32_t) + sizeof(uint32_t);
+	constexpr uint32_t MAX_CHUNK_SIZE = 16 * 1024 * 1024;
 }
 
-void GBCore::writeFrameBuffer(std::ostream& st) const
+const std::array<GBCore::StateSection, GBCore::STATE_SECTION_COUNT> GBCore::STATE_SECTIONS
+{{
+	{
+		makeChunkTag("SYS "),
+		[](const GBCore& gb, StateWriter& st) { const auto system { System::Current() }; ST_WRITE(system); ST_WRITE(gb.cycleCounter); },
+		[](GBCore& gb, StateReader& st) { gb.readSystemState(st); }
+	},
+	{ makeChunkTag("CPU "), [](const GBCore& gb, StateWriter& st) { gb.cpu.saveState(st); }, [](GBCore& gb, StateReader& st) { gb.cpu.loadState(st); } },
+	{ makeChunkTag("PPU "), [](const GBCore& gb, StateWriter& st) { gb.ppu->saveState(st); }, [](GBCore& gb, StateReader& st) { gb.ppu->loadState(st); } },
+	{ makeChunkTag("MMU "), [](const GBCore& gb, StateWriter& st) { gb.mmu.saveState(st); }, [](GBCore& gb, StateReader& st) { gb.mmu.loadState(st); } },
+	{ makeChunkTag("APU "), [](const GBCore& gb, StateWriter& st) { gb.apu.saveState(st); }, [](GBCore& gb, StateReader& st) { gb.apu.loadState(st); } },
+	{ makeChunkTag("SERL"), [](const GBCore& gb, StateWriter& st) { gb.serial.saveState(st); }, [](GBCore& gb, StateReader& st) { gb.serial.loadState(st); } },
+	{ makeChunkTag("JOYP"), [](const GBCore& gb, StateWriter& st) { gb.joypad.saveState(st); }, [](GBCore& gb, StateReader& st) { gb.joypad.loadState(st); } },
+	{ makeChunkTag("MAPR"), [](const GBCore& gb, StateWriter& st) { gb.cartridge.getMapper()->saveState(st); }, [](GBCore& gb, StateReader& st) { gb.cartridge.getMapper()->loadState(st); } }
+}};
+
+void GBCore::writeChunk(StateWriter& st, uint32_t tag, std::span<const uint8_t> data, StateCodec codec)
 {
-	mz_ulong compressedSize { mz_compressBound(PPU::FRAMEBUFFER_SIZE) };
-	std::vector<uint8_t> compressedBuffer(compressedSize);
+	std::vector<uint8_t> compressedBuffer(StateCompression::maxCompressedSize(data.size(), codec));
+	size_t storedSize { StateCompression::compressData(data, compressedBuffer, codec) };
 
-	const auto framebufPtr { reinterpret_cast<const unsigned char*>(ppu->framebufferPtr()) };
-	const int status { mz_compress(compressedBuffer.data(), &compressedSize, framebufPtr, PPU::FRAMEBUFFER_SIZE) };
-
-	const bool isCompressed { status == MZ_OK };
-	ST_WRITE(isCompressed);
-	
-	if (isCompressed)
+	// Small chunks often don't get any smaller.
+	if (storedSize == 0 || storedSize >= data.size())
 	{
-		st.write(reinterpret_cast<const char*>(&compressedSize), sizeof(uint32_t));
-		st.write(reinterpret_cast<const char*>(compressedBuffer.data()), compressedSize);
+		codec = StateCodec::None;
+		storedSize = data.size();
 	}
-	else
-		st.write(reinterpret_cast<const char*>(ppu->framebufferPtr()), PPU::FRAMEBUFFER_SIZE);
+
+	const auto storedSize32 { static_cast<uint32_t>(storedSize) };
+	const auto size { static_cast<uint32_t>(data.size()) };
+
+	ST_WRITE(tag);
+	ST_WRITE(codec);
+	ST_WRITE(storedSize32);
+	ST_WRITE(size);
+
+	const uint8_t* storedData { codec == StateCodec::None ? data.data() : compressedBuffer.data() };
+	st.write(reinterpret_cast<const char*>(storedData), storedSize);
 }
-bool GBCore::loadFrameBuffer(std::istream& st, std::span<uint8_t> framebuffer)
+
+bool GBCore::decodeChunk(const StateChunk& chunk, std::vector<uint8_t>& buffer)
 {
-	bool isCompressed;
-	ST_READ(isCompressed);
+	if (chunk.size > MAX_CHUNK_SIZE)
+		return false;
 
-	if (!isCompressed)
-		st.read(reinterpret_cast<char*>(framebuffer.data()), PPU::FRAMEBUFFER_SIZE);
-	else
-	{
-		uint32_t compressedSize;
-		ST_READ(compressedSize);
+	buffer.resize(chunk.size);
 
-		std::vector<uint8_t> compressedBuffer(compressedSize);
-		st.read(reinterpret_cast<char*>(compressedBuffer.data()), compressedSize);
+	if (chunk.codec != StateCodec::None)
+		return StateCompression::decompressData(chunk.data, buffer, chunk.codec);
 
-		mz_ulong uncompressedSize { PPU::FRAMEBUFFER_SIZE };
-		const auto framebufPtr { reinterpret_cast<unsigned char*>(framebuffer.data()) };
-		const int status { mz_uncompress(framebufPtr, &uncompressedSize, compressedBuffer.data(), compressedSize) };
+	if (chunk.data.size() != chunk.size)
+		return false;
 
-		if (status != MZ_OK)
-			return false;
-	}
+	std::ranges::copy(chunk.data, buffer.begin());
+	return true;
+}
+
+bool GBCore::loadFrameBuffer(const StateChunk& chunk, std::span<uint8_t> framebuffer, PixelFormat format)
+{
+	std::vector<uint8_t> rgbFramebuffer;
+
+	if (chunk.size != PPU::FRAMEBUFFER_SIZE || !decodeChunk(chunk, rgbFramebuffer))
+		return false;
+
+	if (format != PixelFormat::RGB888)
+		PixelOps::convertBuffer(rgbFramebuffer.data(), PixelFormat::RGB888, framebuffer.data(), format, PPU::SCR_WIDTH, PPU::SCR_HEIGHT);
+	else
+		std::memcpy(framebuffer.data(), rgbFramebuffer.data(), PPU::FRAMEBUFFER_SIZE);
 
 	return true;
 }
@@ -554,74 +702,138 @@ bool GBCore::validateAndLoadRom(const std::filesystem::path& romPath, uint8_t ch
 			return false;
 	}
 
+	applyClockPin();
 	return true;
 }
 
 // .mbs SAVE STATE FORMAT (LITTLE ENDIAN):
 // 27 byte save signature (SAVE_STATE_SIGNATURE variable)
-// 8 byte FNV-1a hash of the file (excluding the signature)
+// 8 byte xxHash64 of the file (excluding the signature), FNV-1a before version 111
 // 2 byte save state version number
-// 1 byte ROM cartridge header checksum
-// 2 byte ROM file path (UTF-8) length
-// N byte ROM file path
-// 1 byte isFramebufCompressed flag
-// if isFramebufCompressed is true: 4 byte compressed framebuffer size
-// 69120 bytes of uncompressed or deflate compressed framebuffer data
-// 1 byte isStateCompressed flag
-// if isStateCompressed is true: 4 byte uncompressed state size
-// The rest of the file is uncompressed or deflate compressed GB state data:
-    // 1 byte GB system type (GBSystem enum)
-    // 8 byte cycle counter
-    // CPU -> PPU -> MMU -> APU -> Serial -> Input -> Mapper data. Format is defined in their respective classes, not 100% guaranteed to be compatible between versions.
-
-void GBCore::writeState(std::ostream& os) const
-{
-	std::ostringstream st{};
+// The rest of the file is a list of chunks, each:
+    // 4 byte tag (4 ASCII characters)
+    // 1 byte codec (StateCodec enum: 0 - none, 1 - deflate, 2 - LZ4 block)
+    // 4 byte stored data size
+    // 4 byte uncompressed data size
+    // N byte stored data
+// Chunks can be in any order, unknown ones are skipped:
+    // INFO: 1 byte ROM cartridge header checksum, 2 byte ROM file path (UTF-8) length, N byte ROM file path
+    // THMB: 69120 byte RGB888 framebuffer
+    // SYS : 1 byte GB system type (GBSystem enum), 8 byte cycle counter
+    // CPU , PPU , MMU , APU , SERL (serial), JOYP (input), MAPR (mapper) data. Format is defined in their respective classes, not 100% guaranteed to be compatible between versions.
+// Before version 112 there were no chunks. After the version came the ROM checksum, path length and path, then the thumbnail
+// (codec byte, 4 byte compressed size if compressed, data), then the state codec byte, 4 byte uncompressed size if compressed,
+// and the SYS to MAPR data in one block until the end of the file.
+
+GBCore::StateSnapshot GBCore::snapshotState(StateCodec codec) const
+{
+	StateSnapshot snapshot;
+	snapshot.codec = codec;
 
-	ST_WRITE(SAVE_STATE_VERSION);
+	StateWriter sizeCounter;
+
+	for (size_t i = 0; i < STATE_SECTIONS.size(); i++)
+	{
+		STATE_SECTIONS[i].save(*this, sizeCounter);
+		snapshot.sectionEnds[i] = sizeCounter.size();
+	}
+
+	snapshot.gbState.resize(sizeCounter.size());
+	captureState(snapshot.gbState);
+
+	// Thumbnails are always stored as RGB888, independent of the framebuffer format used by the frontend.
+	const uint8_t* framebufPtr { ppu->framebufferPtr() };
+	snapshot.thumbnail.resize(PPU::FRAMEBUFFER_SIZE);
+
+	if (framebufferFormat != PixelFormat::RGB888)
+		PixelOps::convertBuffer(framebufPtr, framebufferFormat, snapshot.thumbnail.data(), PixelFormat::RGB888, PPU::SCR_WIDTH, PPU::SCR_HEIGHT);
+	else
+		std::memcpy(snapshot.thumbnail.data(), framebufPtr, PPU::FRAMEBUFFER_SIZE);
+
+	snapshot.romPath = FileUtils::pathToUTF8(romFilePath);
+	snapshot.checksum = cartridge.getChecksum();
+	return snapshot;
+}
+void GBCore::queueStateWrite(const std::filesystem::path& path, int saveNum, StateCodec codec, bool updateIndex) const
+{
+	if (!canSaveStateNow())
+		return;
+
+	std::error_code err;
 
-	const auto checksum { cartridge.getChecksum() };
-	ST_WRITE(checksum);
+	if (!std::filesystem::exists(saveStateFolderPath, err))
+		std::filesystem::create_directories(saveStateFolderPath, err);
 
-	const auto romFilePathStr { FileUtils::pathToUTF8(romFilePath) };
-	const auto filePathLen { static_cast<uint16_t>(romFilePathStr.length()) };
+	// Hash and downscaled thumbnail are filled on the writer thread, the slot index is updated once the file is on disk.
+	updateIndex = updateIndex && saveNum > 0 && saveNum < SaveStateIndex::MAX_SLOTS;
+	auto indexEntry { std::make_shared<SaveStateIndex::Entry>() };
 
-	ST_WRITE(filePathLen);
-	st.write(romFilePathStr.data(), filePathLen);
+	const auto write = [snapshot = snapshotState(codec), indexEntry, updateIndex](std::ostream& st)
+	{
+		indexEntry->contentHash = writeState(st, snapshot);
 
-	writeFrameBuffer(st); 
+		if (updateIndex)
+			indexEntry->thumbnail = SaveStateIndex::downscaleThumbnail(snapshot.thumbnail);
+	};
 
-	std::ostringstream gbSt{};
-	writeGBState(gbSt);
+	const auto onComplete = [this, callback = stateSavedCallback, saveNum, path, folder = saveStateFolderPath, indexEntry, updateIndex](bool success)
+	{
+		if (!success)
+			return;
 
-	const auto uncompressedData { gbSt.view().data() };
-	const auto uncompressedSize { static_cast<uint32_t>(gbSt.tellp()) };
+		if (updateIndex && folder == saveStateFolderPath)
+		{
+			syncSaveStateIndex();
 
-	mz_ulong compressedSize { mz_compressBound(uncompressedSize) };
-	std::vector<uint8_t> compressedBuffer(compressedSize);
+			if (SaveStateIndex::readFileInfo(path, *indexEntry))
+				saveStateIndex.update(saveNum, std::move(*indexEntry));
+		}
 
-	const auto dataPtr { reinterpret_cast<const unsigned char*>(uncompressedData) };
-	const int status { mz_compress(compressedBuffer.data(), &compressedSize, dataPtr, uncompressedSize) };
+		if (callback != nullptr)
+			callback(saveNum);
+	};
 
-	const bool isCompressed { status == MZ_OK };
-	ST_WRITE(isCompressed);
+	fileWriter.submit(path, write, onComplete);
+}
+
+uint64_t GBCore::writeState(std::ostream& os, const StateSnapshot& snapshot)
+{
+	const auto filePathLen { static_cast<uint16_t>(snapshot.romPath.length()) };
+	std::vector<uint8_t> info(sizeof(snapshot.checksum) + sizeof(filePathLen) + filePathLen);
 
-	if (isCompressed)
 	{
-		ST_WRITE(uncompressedSize);
-		st.write(reinterpret_cast<const char*>(compressedBuffer.data()), compressedSize);
+		StateWriter st { info };
+		ST_WRITE(snapshot.checksum);
+		ST_WRITE(filePathLen);
+		st.write(snapshot.romPath.data(), filePathLen);
 	}
-	else
-		st.write(uncompressedData, uncompressedSize);
 
-	os.write(SAVE_STATE_SIGNATURE.data(), SAVE_STATE_SIGNATURE.length());
+	const auto maxChunkSize = [&](size_t size) { return CHUNK_HEADER_SIZE + std::max(size, StateCompression::maxCompressedSize(size, snapshot.codec)); };
+	size_t maxSize { sizeof(SAVE_STATE_VERSION) + maxChunkSize(info.size()) + maxChunkSize(snapshot.thumbnail.size()) };
 
-	const auto streamData { st.view().data() };
-	const auto dataSize { static_cast<size_t>(st.tellp()) };
+	for (size_t i = 0, sectionStart = 0; i < STATE_SECTIONS.size(); sectionStart = snapshot.sectionEnds[i++])
+		maxSize += maxChunkSize(snapshot.sectionEnds[i] - sectionStart);
 
-	const uint64_t hash { calculateHash({ reinterpret_cast<const uint8_t*>(streamData), dataSize }) };
+	std::vector<uint8_t> buffer(maxSize);
+	StateWriter st { buffer };
+
+	ST_WRITE(SAVE_STATE_VERSION);
+
+	writeChunk(st, INFO_CHUNK, info, StateCodec::None);
+	writeChunk(st, THUMBNAIL_CHUNK, snapshot.thumbnail, snapshot.codec);
+
+	for (size_t i = 0, sectionStart = 0; i < STATE_SECTIONS.size(); sectionStart = snapshot.sectionEnds[i++])
+	{
+		const std::span<const uint8_t> section { snapshot.gbState.data() + sectionStart, snapshot.sectionEnds[i] - sectionStart };
+		writeChunk(st, STATE_SECTIONS[i].tag, section, snapshot.codec);
+	}
+
+	os.write(SAVE_STATE_SIGNATURE.data(), SAVE_STATE_SIGNATURE.length());
+
+	const uint64_t hash { calculateHash(st.data(), SAVE_STATE_VERSION) };
 	os.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
-	os.write(streamData, dataSize);
+	os.write(reinterpret_cast<const char*>(st.data().data()), st.size());
+	return hash;
 }
 
 std::vector<uint8_t> GBCore::getStateData(std::istream& st)
@@ -632,12 +844,104 @@ std::vector<uint8_t> GBCore::getStateData(std::istream& st)
 	std::vector<uint8_t> buffer(FileUtils::remainingBytes(st));
 	st.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
 
-	if (calculateHash(buffer) != storedHash)
+	// Hash function depends on the version, which is the first field of the hashed data.
+	uint16_t saveStateVersion { 0 };
+
+	if (buffer.size() < sizeof(saveStateVersion))
+		return {};
+
+	std::memcpy(&saveStateVersion, buffer.data(), sizeof(saveStateVersion));
+
+	if (calculateHash(buffer, saveStateVersion) != storedHash)
 		return {};
 
 	return buffer;
 }
 
+bool GBCore::parseStateFile(std::span<const uint8_t> data, StateFile& file)
+{
+	StateReader st { data };
+	ST_READ(file.version);
+
+	if (!st.good() || !isSaveStateVersionSupported(file.version))
+		return false;
+
+	if (file.version < CHUNKED_SAVE_STATE_VERSION)
+		return parseLegacyStateFile(st, file);
+
+	while (st.remaining() != 0)
+	{
+		StateChunk chunk;
+		uint32_t storedSize { 0 };
+
+		ST_READ(chunk.tag);
+		ST_READ(chunk.codec);
+		ST_READ(storedSize);
+		ST_READ(chunk.size);
+
+		if (!st.good() || storedSize > st.remaining())
+			return false;
+
+		chunk.data = st.remainingData().first(storedSize);
+		st.skip(storedSize);
+
+		file.chunks.push_back(chunk);
+	}
+
+	const StateChunk* info { file.findChunk(INFO_CHUNK) };
+
+	if (info == nullptr || info->codec != StateCodec::None)
+		return false;
+
+	StateReader infoSt { info->data };
+	uint16_t filePathLen { 0 };
+
+	infoSt.read(reinterpret_cast<char*>(&file.romChecksum), sizeof(file.romChecksum));
+	infoSt.read(reinterpret_cast<char*>(&filePathLen), sizeof(filePathLen));
+
+	file.romPath.resize(std::min<size_t>(filePathLen, infoSt.remaining()));
+	infoSt.read(file.romPath.data(), file.romPath.size());
+
+	return infoSt.good();
+}
+bool GBCore::parseLegacyStateFile(StateReader& st, StateFile& file)
+{
+	ST_READ(file.romChecksum);
+
+	uint16_t filePathLen { 0 };
+	ST_READ(filePathLen);
+
+	file.romPath.resize(std::min<size_t>(filePathLen, st.remaining()));
+	st.read(file.romPath.data(), file.romPath.size());
+
+	StateChunk thumbnail { THUMBNAIL_CHUNK, StateCodec::None, PPU::FRAMEBUFFER_SIZE, {} };
+	uint32_t thumbnailSize { PPU::FRAMEBUFFER_SIZE };
+	ST_READ(thumbnail.codec);
+
+	if (thumbnail.codec != StateCodec::None)
+		ST_READ(thumbnailSize);
+
+	if (!st.good() || thumbnailSize > st.remaining())
+		return false;
+
+	thumbnail.data = st.remainingData().first(thumbnailSize);
+	st.skip(thumbnailSize);
+
+	StateChunk state { LEGACY_STATE_CHUNK, StateCodec::None, 0, {} };
+	ST_READ(state.codec);
+
+	if (state.codec != StateCodec::None)
+		ST_READ(state.size);
+
+	state.data = st.remainingData();
+
+	if (state.codec == StateCodec::None)
+		state.size = static_cast<uint32_t>(state.data.size());
+
+	file.chunks = { thumbnail, state };
+	return st.good();
+}
+
 FileLoadResult GBCore::loadState(std::istream& is)
 {
 	const auto buffer { getStateData(is) };
@@ -645,96 +949,113 @@ FileLoadResult GBCore::loadState(std::istream& is)
 	if (buffer.empty())
 		return FileLoadResult::CorruptSaveState;
 
-	memstream st { buffer };
+	StateFile file;
+	const bool parsed { parseStateFile(buffer, file) };
 
-	uint16_t saveStateVersion;
-	ST_READ(saveStateVersion);
-
-	if (saveStateVersion != SAVE_STATE_VERSION)
+	if (!isSaveStateVersionSupported(file.version))
 		return FileLoadResult::SaveStateVersionError;
 
-	uint8_t stateRomChecksum;
-	ST_READ(stateRomChecksum);
-
-	uint16_t filePathLen;
-	ST_READ(filePathLen);
-
-	std::string romPath(filePathLen, 0);
-	st.read(romPath.data(), filePathLen);
+	if (!parsed)
+		return FileLoadResult::CorruptSaveState;
 
-	if (!cartridge.loaded() || cartridge.getChecksum() != stateRomChecksum)
+	if (!cartridge.loaded() || cartridge.getChecksum() != file.romChecksum)
 	{
-		if (!validateAndLoadRom(romPath, stateRomChecksum))
+		if (!validateAndLoadRom(file.romPath, file.romChecksum))
 			return FileLoadResult::ROMNotFound;
 	}
 
-	const uint32_t framebufDataOffset { static_cast<uint32_t>(st.tellg()) };
+	if (!loadStateChunks(file))
+		return FileLoadResult::CorruptSaveState;
 
-	bool isFramebufCompressed;
-	ST_READ(isFramebufCompressed);
+	// For the first frame not to be as teared.
+	if (const auto thumbnail { file.findChunk(THUMBNAIL_CHUNK) })
+		loadFrameBuffer(*thumbnail, { ppu->backbufferPtr(), ppu->framebufferSize() }, framebufferFormat);
 
-	if (isFramebufCompressed)
-	{
-		uint32_t compressedSize;
-		ST_READ(compressedSize);
-		st.seekg(compressedSize, std::ios::cur);
-	}
-	else
-		st.seekg(PPU::FRAMEBUFFER_SIZE, std::ios::cur); 
+	std::memcpy(ppu->framebufferPtr(), ppu->backbufferPtr(), ppu->framebufferSize()); // Keep changed scanline detection relative to the displayed frame.
 
-	bool isStateCompressed;
-	ST_READ(isStateCompressed);
+	if (drawCallback != nullptr)
+		drawCallback(ppu->backbufferPtr(), true);
 
-	if (!isStateCompressed)
-		readGBState(st);
-	else
+	return FileLoadResult::SuccessSaveState;
+}
+bool GBCore::loadStateChunks(const StateFile& file)
+{
+	// Sections are applied one by one, so the current state is kept to roll back to if a later one turns out to be corrupt.
+	std::vector<uint8_t> prevState(captureState({}));
+	captureState(prevState);
+
+	if (applyStateChunks(file))
+		return true;
+
+	restoreState(prevState);
+	return false;
+}
+bool GBCore::applyStateChunks(const StateFile& file)
+{
+	if (const auto legacyState { file.findChunk(LEGACY_STATE_CHUNK) })
 	{
-		mz_ulong uncompressedSize { 0 };
-		st.read(reinterpret_cast<char*>(&uncompressedSize), sizeof(uint32_t));
+		std::vector<uint8_t> gbState;
 
-		const auto compressedSize { static_cast<mz_ulong>(FileUtils::remainingBytes(st)) };
+		if (!decodeChunk(*legacyState, gbState))
+			return false;
 
-		std::vector<uint8_t> compressedBuffer(compressedSize);
-		st.read(reinterpret_cast<char*>(compressedBuffer.data()), compressedSize);
+		StateReader st { gbState };
+		readGBState(st);
+		return st.good();
+	}
 
-		std::vector<uint8_t> buffer(uncompressedSize);
-		const auto bufPtr { reinterpret_cast<unsigned char*>(buffer.data()) };
-		const int status { mz_uncompress(bufPtr, &uncompressedSize, compressedBuffer.data(), compressedSize) };
+	// Everything is decoded first, so a corrupt chunk doesn't leave the emulator half loaded.
+	std::array<std::vector<uint8_t>, STATE_SECTION_COUNT> sections;
 
-		if (status != MZ_OK)
-			return FileLoadResult::CorruptSaveState;
+	for (size_t i = 0; i < STATE_SECTIONS.size(); i++)
+	{
+		const auto chunk { file.findChunk(STATE_SECTIONS[i].tag) };
 
-		memstream ms { buffer };
-		readGBState(ms);
+		if (chunk == nullptr || !decodeChunk(*chunk, sections[i]))
+			return false;
 	}
 
-	// For the first frame not to be as teared.
-	st.seekg(framebufDataOffset, std::ios::beg);
-	loadFrameBuffer(st, { ppu->backbufferPtr(), PPU::FRAMEBUFFER_SIZE });
+	for (size_t i = 0; i < STATE_SECTIONS.size(); i++)
+	{
+		StateReader st { sections[i] };
+		STATE_SECTIONS[i].load(*this, st);
 
-	if (drawCallback != nullptr)
-		drawCallback(ppu->backbufferPtr(), true);
+		if (!st.good())
+			return false;
+	}
 
-	return FileLoadResult::SuccessSaveState;
+	return true;
 }
 
-void GBCore::writeGBState(std::ostream& st) const
+size_t GBCore::captureState(std::span<uint8_t> buffer) const
+{
+	StateWriter st { buffer };
+	writeGBState(st);
+	return st.size();
+}
+bool GBCore::restoreState(std::span<const uint8_t> data)
 {
-	const auto system { System::Current() };
-	ST_WRITE(system);
-	ST_WRITE(cycleCounter);
+	if (!cartridge.loaded())
+		return false;
 
-	cpu.saveState(st);
-	ppu->saveState(st);
-	mmu.saveState(st);
-	apu.saveState(st);
-	serial.saveState(st);
-	joypad.saveState(st);
-	cartridge.getMapper()->saveState(st);
+	StateReader st { data };
+	readGBState(st);
+	return st.good();
+}
+
+void GBCore::writeGBState(StateWriter& st) const
+{
+	for (const auto& section : STATE_SECTIONS)
+		section.save(*this, st);
 }
-void GBCore::readGBState(std::istream& st)
+void GBCore::readGBState(StateReader& st)
 {
-	GBSystem system;
+	for (const auto& section : STATE_SECTIONS)
+		section.load(*this, st);
+}
+void GBCore::readSystemState(StateReader& st)
+{
+	GBSystem system { System::Current() };
 	ST_READ(system);
 
 	if (System::Current() != system)
@@ -745,49 +1066,189 @@ void GBCore::readGBState(std::istream& st)
 
 	// Passing false to fullReset, because boot rom shouldn't be loaded and system should stay the one specified in save state.
 	// Also passing false to clearBuf, since save state thumbnail will be used as first frame instead of blank frame. 
-	reset(true, false, false);
+	// RAM is fully overwritten by the state, so it isn't randomized (and battery RAM isn't reset) to keep in-memory restores fast.
+	reset(false, false, false, false);
 	mmu.isBootROMMapped = false;
 
 	ST_READ(cycleCounter);
-
-	cpu.loadState(st);
-	ppu->loadState(st);
-	mmu.loadState(st);
-	apu.loadState(st);
-	serial.loadState(st);
-	joypad.loadState(st);
-	cartridge.getMapper()->loadState(st);
 }
 
 bool GBCore::loadSaveStateThumbnail(const std::filesystem::path& path, std::span<uint8_t> framebuffer) const
+{
+	std::vector<uint8_t> rgbThumbnail;
+	uint64_t fileHash;
+
+	if (!readStateThumbnail(path, rgbThumbnail, fileHash))
+		return false;
+
+	if (framebufferFormat != PixelFormat::RGB888)
+		PixelOps::convertBuffer(rgbThumbnail.data(), PixelFormat::RGB888, framebuffer.data(), framebufferFormat, PPU::SCR_WIDTH, PPU::SCR_HEIGHT);
+	else
+		std::memcpy(framebuffer.data(), rgbThumbnail.data(), PPU::FRAMEBUFFER_SIZE);
+
+	return true;
+}
+bool GBCore::readStateThumbnail(const std::filesystem::path& path, std::vector<uint8_t>& rgbThumbnail, uint64_t& fileHash) const
 {
 	if (!cartridge.loaded())
 		return false;
 
+	std::ifstream st { path, std::ios::in | std::ios::binary };
+
+	if (!st || !isSaveStateFile(st))
+		return false;
+
+	// Save state lists load many thumbnails at once: the hash isn't checked, and only the chunk headers, INFO and THMB are read.
+	uint16_t version { 0 };
+	ST_READ(fileHash);
+	ST_READ(version);
+
+	if (!st || !isSaveStateVersionSupported(version))
+		return false;
+
+	uint8_t romChecksum { 0 };
+	StateChunk thumbnail { THUMBNAIL_CHUNK, StateCodec::None, PPU::FRAMEBUFFER_SIZE, {} };
+	std::vector<uint8_t> thumbnailData;
+
+	const auto readThumbnailData = [&](uint32_t storedSize)
+	{
+		if (storedSize > MAX_CHUNK_SIZE)
+			return false;
+
+		thumbnailData.resize(storedSize);
+		st.read(reinterpret_cast<char*>(thumbnailData.data()), storedSize);
+		return static_cast<bool>(st);
+	};
+
+	if (version < CHUNKED_SAVE_STATE_VERSION)
+	{
+		uint16_t filePathLen { 0 };
+		uint32_t thumbnailSize { PPU::FRAMEBUFFER_SIZE };
+
+		ST_READ(romChecksum);
+		ST_READ(filePathLen);
+		st.seekg(filePathLen, std::ios::cur);
+		ST_READ(thumbnail.codec);
+
+		if (thumbnail.codec != StateCodec::None)
+			ST_READ(thumbnailSize);
+
+		if (!st || !readThumbnailData(thumbnailSize))
+			return false;
+	}
+	else
+	{
+		bool foundInfo { false }, foundThumbnail { false };
+
+		while (!foundInfo || !foundThumbnail)
+		{
+			uint32_t tag { 0 }, storedSize { 0 }, size { 0 };
+			StateCodec codec { StateCodec::None };
+
+			ST_READ(tag);
+			ST_READ(codec);
+			ST_READ(storedSize);
+			ST_READ(size);
+
+			if (!st)
+				return false;
+
+			if (tag == INFO_CHUNK && codec == StateCodec::None && storedSize >= sizeof(romChecksum))
+			{
+				ST_READ(romChecksum);
+				st.seekg(storedSize - sizeof(romChecksum), std::ios::cur);
+				foundInfo = true;
+			}
+			else if (tag == THUMBNAIL_CHUNK)
+			{
+				if (!readThumbnailData(storedSize))
+					return false;
+
+				thumbnail.codec = codec;
+				thumbnail.size = size;
+				foundThumbnail = true;
+			}
+			else
+				st.seekg(storedSize, std::ios::cur);
+		}
+	}
+
+	if (!st || romChecksum != cartridge.getChecksum())
+		return false;
+
+	thumbnail.data = thumbnailData;
+	return thumbnail.size == PPU::FRAMEBUFFER_SIZE && decodeChunk(thumbnail, rgbThumbnail);
+}
+bool GBCore::readStateFileHash(const std::filesystem::path& path, uint64_t& fileHash)
+{
 	std::ifstream ifs { path, std::ios::in | std::ios::binary };
 
 	if (!ifs || !isSaveStateFile(ifs))
 		return false;
 
-	const auto buffer { getStateData(ifs) };
+	ifs.read(reinterpret_cast<char*>(&fileHash), sizeof(fileHash));
+	return static_cast<bool>(ifs);
+}
 
-	if (buffer.empty())
+bool GBCore::loadSaveSlotThumbnail(int num, std::span<uint8_t> thumbnail)
+{
+	if (!cartridge.loaded() || num <= 0 || num >= SaveStateIndex::MAX_SLOTS)
 		return false;
 
-	memstream st { buffer };
-
-	uint16_t saveStateVersion;
-	ST_READ(saveStateVersion);
+	syncSaveStateIndex();
 
-	uint8_t saveStateChecksum;
-	ST_READ(saveStateChecksum);
+	const auto path { getSaveStatePath(num) };
+	SaveStateIndex::Entry fileInfo;
 
-	if (cartridge.getChecksum() != saveStateChecksum || saveStateVersion != SAVE_STATE_VERSION)
+	if (!SaveStateIndex::readFileInfo(path, fileInfo))
 		return false;
 
-	uint16_t filePathLen { 0 };
-	ST_READ(filePathLen);
-	st.seekg(filePathLen, std::ios::cur);
+	const auto& entry { saveStateIndex.get(num) };
+
+	if (!entry.matchesFile(fileInfo))
+	{
+		// Same contents with a different modification time (e.g. copied back from a backup) only need the header read.
+		if (!entry.empty() && entry.fileSize == fileInfo.fileSize && readStateFileHash(path, fileInfo.contentHash) && fileInfo.contentHash == entry.contentHash)
+			fileInfo.thumbnail = entry.thumbnail;
+		else
+		{
+			std::vector<uint8_t> rgbThumbnail;
+
+			if (!readStateThumbnail(path, rgbThumbnail, fileInfo.contentHash))
+				return false;
 
-	return loadFrameBuffer(st, framebuffer);
-}
\ No newline at end of file
+			fileInfo.thumbnail = SaveStateIndex::downscaleThumbnail(rgbThumbnail);
+		}
+
+		saveStateIndex.update(num, std::move(fileInfo));
+	}
+
+	const auto& rgbThumbnail { saveStateIndex.get(num).thumbnail };
+
+	if (framebufferFormat != PixelFormat::RGB888)
+		PixelOps::convertBuffer(rgbThumbnail.data(), PixelFormat::RGB888, thumbnail.data(), framebufferFormat, SaveStateIndex::THUMBNAIL_WIDTH, SaveStateIndex::THUMBNAIL_HEIGHT);
+	else
+		std::memcpy(thumbnail.data(), rgbThumbnail.data(), SaveStateIndex::THUMBNAIL_SIZE);
+
+	return true;
+}
+
+void GBCore::syncSaveStateIndex() const
+{
+	if (saveStateIndex.folder() != saveStateFolderPath)
+		saveStateIndex.load(saveStateFolderPath);
+}
+void GBCore::writeSaveStateIndex()
+{
+	if (!saveStateIndex.dirty)
+		return;
+
+	std::ostringstream st;
+	saveStateIndex.write(st);
+	saveStateIndex.dirty = false;
+
+	fileWriter.submit(saveStateIndex.filePath(), [index = std::move(st).str()](std::ostream& os)
+	{
+		os.write(index.data(), index.size());
+	});
+}
@@ -2,6 +2,8 @@
 #include <filesystem>
 #include <span>
 #include <atomic>
+#include <optional>
+#include <algorithm>
 
 #include "MMU.h"
 #include "CPU/CPU.h"
@@ -11,7 +13,12 @@
 #include "SerialPort.h"
 #include "Cartridge.h"
 #include "appConfig.h"
+#include "saveStateIndex.h"
 #include "Utils/fileUtils.h"
+#include "Utils/asyncFileWriter.h"
+#include "Utils/incrementalFile.h"
+#include "Utils/stateCompression.h"
+#include "Utils/rngOps.h"
 
 enum class FileLoadResult
 {
@@ -86,18 +93,37 @@ public:
 	{
 		if (enableBreakpointChecks)
 			emulateFrameBase<true>();
+		else if (runAheadFrames != 0 && speedFactor == 1 && cartridge.loaded())
+			emulateFrameRunAhead();
 		else
 			emulateFrameBase<false>();
 	}
 
+	static constexpr int MAX_RUN_AHEAD_FRAMES = 4;
+
+	// Each frame also emulates this many frames ahead with the current input and presents the last of them, then rolls back.
+	// Hides the game's own input lag. Disabled while fast forwarding or when breakpoints are enabled.
+	inline void setRunAheadFrames(int frames) { runAheadFrames = std::clamp(frames, 0, MAX_RUN_AHEAD_FRAMES); }
+	inline int getRunAheadFrames() const { return runAheadFrames; }
+
 	inline bool executingBootROM() const { return mmu.isBootROMMapped; }
 	inline bool executingProgram() const { return cartridge.loaded() || mmu.isBootROMMapped; }
 
 	inline void setDrawCallback(void (*callback)(const uint8_t*, bool)) { drawCallback = callback; }
+
+	inline void setFramebufferFormat(PixelFormat format)
+	{
+		framebufferFormat = format;
+		ppu->setFramebufferFormat(format);
+	}
+	inline PixelFormat getFramebufferFormat() const { return framebufferFormat; }
 	inline void setBootRomExitCallback(void(*callback)()) { bootRomExitCallback = callback; }
 
 	static constexpr std::string_view SAVE_STATE_SIGNATURE = "MegaBoy Emulator Save State";
-	static constexpr uint16_t SAVE_STATE_VERSION = 110; // 1.1.0 | Update after making breaking change to the save state format.
+	static constexpr uint16_t SAVE_STATE_VERSION = 112; // 1.1.2 | Update after making breaking change to the save state format. Adding new chunks isn't one.
+	static constexpr uint16_t MIN_SAVE_STATE_VERSION = 110; // Oldest version that still loads, 1.1.0 states only differ in the file hash.
+
+	static constexpr bool isSaveStateVersionSupported(uint16_t version) { return version >= MIN_SAVE_STATE_VERSION && version <= SAVE_STATE_VERSION; }
 
 	static bool isSaveStateFile(std::istream& st);
 
@@ -109,6 +135,13 @@ public:
 		return loadFile(st, filePath, loadBatteryOnRomload);
 	}
 
+	// Loads just the ROM: no battery save, and the config file isn't updated. For headless tools, so batch runs leave the user's config alone.
+	inline bool loadROMFile(const std::filesystem::path& filePath)
+	{
+		std::ifstream st { filePath, std::ios::in | std::ios::binary };
+		return st && loadROM(st, filePath);
+	}
+
 	bool runNoCartridgeBootROM(GBSystem bootSys);
 
 	inline void loadCurrentBatterySave() const
@@ -116,7 +149,13 @@ public:
 		if (!cartridge.hasBattery || !appConfig::batterySaves)
 			return;
 
-		if (std::ifstream st { getBatteryFilePath(), std::ios::in | std::ios::binary })
+		fileWriter.flush();
+
+		const auto batteryFilePath { getBatteryFilePath() };
+		IncrementalFile::recover(batteryFilePath);
+		batteryFile.invalidate();
+
+		if (std::ifstream st { batteryFilePath, std::ios::in | std::ios::binary })
 		{
 			backupBatteryFile();
 			cartridge.getMapper()->loadBattery(st);
@@ -126,17 +165,41 @@ public:
 	FileLoadResult loadState(const std::filesystem::path& path);
 	FileLoadResult loadState(int num);
 	bool loadSaveStateThumbnail(const std::filesystem::path& path, std::span<uint8_t> framebuffer) const;
+	// Downscaled (SaveStateIndex::THUMBNAIL_WIDTH x THUMBNAIL_HEIGHT) thumbnail of a save slot, in the framebuffer format.
+	// Comes from the slot index while it's up to date, otherwise it's decoded from the state file and the index is updated.
+	bool loadSaveSlotThumbnail(int num, std::span<uint8_t> thumbnail);
 
 	constexpr bool canSaveStateNow() const { return cartridge.loaded() && !mmu.isBootROMMapped; }
 
-	void saveState(const std::filesystem::path& path) const;
+	// Raw in-memory snapshot of the emulated machine (no header, thumbnail, compression or hash), for rewind and similar.
+	// Doesn't allocate. Returns the size the state needs; nothing usable is written if it's larger than the buffer,
+	// so an empty buffer can be passed to query the size. The size can vary slightly depending on the PPU mode.
+	size_t captureState(std::span<uint8_t> buffer) const;
+	// Returns false if data is truncated. State must come from captureState with the same ROM loaded.
+	bool restoreState(std::span<const uint8_t> data);
+
+	// Files are written in the background: the state is snapshotted right away, compressed and written by the file writer thread.
+	// Save slots and autosaves are written with the fast codec, other paths default to the smaller deflate (e.g. exports).
+	void saveState(const std::filesystem::path& path, StateCodec codec = StateCodec::Deflate) const;
 	void saveState(int num);
 
-	inline void saveState(std::ostream& st) const
+	inline void saveState(std::ostream& st, StateCodec codec = StateCodec::Deflate) const
 	{
 		if (!canSaveStateNow()) return;
-		writeState(st);
+		writeState(st, snapshotState(codec));
+	}
+
+	// Called once a save state file has been written, with the save slot number (0 if it wasn't saved to a slot).
+	inline void setStateSavedCallback(void (*callback)(int saveNum)) { stateSavedCallback = callback; }
+
+	// Runs callbacks of finished background writes and queues the slot index if it changed. Call regularly from the frontend thread.
+	inline void pollFileWrites()
+	{
+		fileWriter.dispatchCompletions();
+		writeSaveStateIndex();
 	}
+	// Blocks until all queued save state and battery writes are on disk, e.g. before exiting.
+	inline void waitForFileWrites() const { fileWriter.flush(); }
 
 	constexpr void unbindSaveState() { currentSave = 0; }
 	constexpr int getSaveNum() const { return currentSave; }
@@ -221,6 +284,18 @@ public:
 			cartridge.rtc->disableFastForward();
 	}
 
+	// While pinned, the cartridge RTC reads this time plus the emulated time instead of the wall clock.
+	inline void pinClock(uint64_t unixTime)
+	{
+		pinnedClockTime = unixTime;
+		applyClockPin();
+	}
+	inline void unpinClock()
+	{
+		pinnedClockTime.reset();
+		applyClockPin();
+	}
+
 	std::vector<gameGenieCheat> gameGenies{};
 	std::vector<gameSharkCheat> gameSharks{};
 
@@ -229,6 +304,8 @@ public:
 
 	std::string gameTitle{ };
 
+	RngOps::Xoshiro256 rng;
+
 	MMU mmu { *this };
 	CPU cpu { *this };
 	std::unique_ptr<PPU> ppu;
@@ -239,11 +316,22 @@ public:
 private:
 	void (*drawCallback)(const uint8_t* framebuffer, bool firstFrame) { nullptr };
 	void (*bootRomExitCallback)() { nullptr };
+	void (*stateSavedCallback)(int saveNum) { nullptr };
+
+	mutable AsyncFileWriter fileWriter;
+	mutable SaveStateIndex saveStateIndex;
+	mutable IncrementalFile batteryFile;
 
 	bool ppuDebugEnable { false };
+	PixelFormat framebufferFormat { PixelFormat::RGB888 };
 
 	uint64_t cycleCounter { 0 };
 	int speedFactor { 1 };
+	std::optional<uint64_t> pinnedClockTime;
+
+	int runAheadFrames { 0 };
+	bool presentFrames { true };
+	std::vector<uint8_t> runAheadState;
 
 	uint64_t frameCounter { 0 };
 	uint64_t cpuUsageCycles { 0 };
@@ -261,6 +349,10 @@ private:
 
 	template<bool checkBreakpoints>
 	void emulateFrameBase();
+	void emulateFrameRunAhead();
+
+	template<bool checkBreakpoints>
+	bool runUntil(uint64_t targetCycles);
 
 	void stepComponents();
 
@@ -275,7 +367,18 @@ private:
 		appConfig::updateConfigFile();
 	}
 
-	void reset(bool resetBattery, bool clearBuf = true, bool fullReset = true);
+	inline void applyClockPin()
+	{
+		if (cartridge.rtc == nullptr)
+			return;
+
+		if (pinnedClockTime.has_value())
+			cartridge.rtc->pinClock(*pinnedClockTime, &cycleCounter);
+		else
+			cartridge.rtc->unpinClock();
+	}
+
+	void reset(bool resetBattery, bool clearBuf = true, bool fullReset = true, bool randomizeRAM = true);
 	void updatePPUSystem();
 
 	void loadBootROM();
@@ -290,16 +393,87 @@ private:
 	bool loadROM(std::istream& st, const std::filesystem::path& filePath);
 	static std::vector<uint8_t> extractZippedROM(std::istream& st);
 
-	static uint64_t calculateHash(std::span<const uint8_t> data);
+	// For a battery loaded from a .sav directly: it replaces what the incremental writer last wrote, and an old journal mustn't be recovered over it.
+	inline void discardBatteryFileState() const
+	{
+		batteryFile.invalidate();
+		IncrementalFile::discardJournal(getBatteryFilePath());
+	}
 
-	void writeState(std::ostream& st) const;
-	void writeFrameBuffer(std::ostream& st) const;
+	static constexpr uint16_t XXHASH_SAVE_STATE_VERSION = 111; // States before it are hashed with FNV-1a.
+	static constexpr uint16_t CHUNKED_SAVE_STATE_VERSION = 112; // States before it store the whole machine state in one block.
+	static uint64_t calculateHash(std::span<const uint8_t> data, uint16_t saveStateVersion);
+
+	// Machine state is saved in these sections, in this order. Save state files store each one in its own chunk.
+	struct StateSection
+	{
+		uint32_t tag;
+		void (*save)(const GBCore& gb, StateWriter& st);
+		void (*load)(GBCore& gb, StateReader& st);
+	};
+
+	static constexpr size_t STATE_SECTION_COUNT = 8;
+	static const std::array<StateSection, STATE_SECTION_COUNT> STATE_SECTIONS;
+
+	// Everything needed to write a save state file, copied so it can be written while emulation continues.
+	struct StateSnapshot
+	{
+		std::vector<uint8_t> gbState;
+		std::array<size_t, STATE_SECTION_COUNT> sectionEnds;
+		std::vector<uint8_t> thumbnail; // RGB888
+		std::string romPath;
+		uint8_t checksum;
+		StateCodec codec;
+	};
+
+	StateSnapshot snapshotState(StateCodec codec) const;
+	// Autosaves don't update the slot index, their entry is refreshed from the file when the slot thumbnail is next loaded.
+	void queueStateWrite(const std::filesystem::path& path, int saveNum, StateCodec codec, bool updateIndex = true) const;
+
+	// Returns the file hash.
+	static uint64_t writeState(std::ostream& st, const StateSnapshot& snapshot);
+	static void writeChunk(StateWriter& st, uint32_t tag, std::span<const uint8_t> data, StateCodec codec);
+
+	struct StateChunk
+	{
+		uint32_t tag;
+		StateCodec codec;
+		uint32_t size; // Uncompressed.
+		std::span<const uint8_t> data;
+	};
+
+	// Parsed save state file, chunk data points into the file buffer.
+	struct StateFile
+	{
+		uint16_t version { 0 };
+		uint8_t romChecksum { 0 };
+		std::string romPath;
+		std::vector<StateChunk> chunks;
+
+		inline const StateChunk* findChunk(uint32_t tag) const
+		{
+			const auto it { std::ranges::find(chunks, tag, &StateChunk::tag) };
+			return it != chunks.end() ? &*it : nullptr;
+		}
+	};
 
 	static std::vector<uint8_t> getStateData(std::istream& st);
-	static bool loadFrameBuffer(std::istream& st, std::span<uint8_t> framebuffer);
+	static bool parseStateFile(std::span<const uint8_t> data, StateFile& file);
+	static bool parseLegacyStateFile(StateReader& st, StateFile& file);
+	static bool decodeChunk(const StateChunk& chunk, std::vector<uint8_t>& buffer);
+
+	static bool loadFrameBuffer(const StateChunk& chunk, std::span<uint8_t> framebuffer, PixelFormat format);
+	bool readStateThumbnail(const std::filesystem::path& path, std::vector<uint8_t>& rgbThumbnail, uint64_t& fileHash) const;
+	static bool readStateFileHash(const std::filesystem::path& path, uint64_t& fileHash);
+
+	void syncSaveStateIndex() const;
+	void writeSaveStateIndex();
 	FileLoadResult loadState(std::istream& st);
+	bool loadStateChunks(const StateFile& file);
+	bool applyStateChunks(const StateFile& file);
 	bool validateAndLoadRom(const std::filesystem::path& romPath, uint8_t checksum);
 
-	void writeGBState(std::ostream& st) const;
-	void readGBState(std::istream& st);
+	void writeGBState(StateWriter& st) const;
+	void readGBState(StateReader& st);
+	void readSystemState(StateReader& st);
 };
\ No newline at end of file
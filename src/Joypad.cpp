@@ -16,32 +16,49 @@ void Joypad::reset()
 		readDpad = true;
 	}
 
-	dpadState = 0xF;
-	buttonState = 0xF;
+	// Held buttons aren't reset: they are host input, not emulated state. Releasing them here would drop held keys
+	// on every state restore (run-ahead rollbacks, rewind), since states don't store them.
 }
 
 void Joypad::update(int key, bool action)
 {
-	const auto updateInput = [&](uint8_t& keyState, bool readGroup, int keyConfigOffset) -> bool
+	for (int n = 0; n < 8; n++)
 	{
-		for (int i = keyConfigOffset; i < 4 + keyConfigOffset; i++)
+		const int i { (n + 4) & 7 }; // Dpad binds take priority.
+
+		if (key == KeyBindManager::keyBinds[i])
 		{
-			if (key == KeyBindManager::keyBinds[i])
-			{
-				keyState = setBit(keyState, i - keyConfigOffset, !action);
+			setButton(static_cast<MegaBoyKey>(i), action);
+			return;
+		}
+	}
+}
 
-				if (action && readGroup)
-					cpu.requestInterrupt(Interrupt::Joypad);
+void Joypad::setButton(MegaBoyKey button, bool pressed)
+{
+	const int index { static_cast<int>(button) };
+	const bool isDpad { index >= 4 };
 
-				return true;
-			}
-		}
+	uint8_t& keyState { isDpad ? dpadState : buttonState };
+	keyState = setBit(keyState, index & 3, !pressed);
 
-		return false;
-	};
+	if (pressed && (isDpad ? readDpad : readButtons))
+		cpu.requestInterrupt(Interrupt::Joypad);
+}
 
-	if (updateInput(dpadState, readDpad, 4)) return;
-	updateInput(buttonState, readButtons, 0);
+uint8_t Joypad::getButtons() const
+{
+	return static_cast<uint8_t>(~(buttonState | (dpadState << 4)));
+}
+void Joypad::setButtons(uint8_t buttons)
+{
+	const uint8_t changed { static_cast<uint8_t>(buttons ^ getButtons()) };
+
+	for (int i = 0; i < 8; i++)
+	{
+		if (getBit(changed, i))
+			setButton(static_cast<MegaBoyKey>(i), getBit(buttons, i));
+	}
 }
 
 uint8_t Joypad::readInputReg() const
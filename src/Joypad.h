@@ -3,8 +3,10 @@
 #include <cstdint>
 #include <iostream>
 #include "defines.h"
+#include "Utils/stateStream.h"
 
 class CPU;
+enum class MegaBoyKey;
 
 class Joypad
 {
@@ -13,13 +15,20 @@ public:
 	{}
 	           
 	void update(int key, bool action);
+
+	// For input that doesn't come from key binds (e.g. scripted input). Only A to Down are valid.
+	void setButton(MegaBoyKey button, bool pressed);
+
+	// Bit n is set while MegaBoyKey n (A to Down) is held.
+	uint8_t getButtons() const;
+	void setButtons(uint8_t buttons);
 	void reset();
 
 	uint8_t readInputReg() const;
 	void writeInputReg(uint8_t val);
 
-	inline void saveState(std::ostream& st) const { ST_WRITE(readButtons), ST_WRITE(readDpad); }
-	inline void loadState(std::istream& st) { ST_READ(readButtons), ST_READ(readDpad); }
+	inline void saveState(StateWriter& st) const { ST_WRITE(readButtons), ST_WRITE(readDpad); }
+	inline void loadState(StateReader& st) { ST_READ(readButtons), ST_READ(readDpad); }
 private:
 	CPU& cpu;
 
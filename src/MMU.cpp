@@ -1,7 +1,6 @@
 #include "MMU.h"
 #include "GBCore.h"
 #include "defines.h"
-#include "Utils/rngOps.h"
 
 MMU::MMU(GBCore& gb) : gb(gb) { updateSystem(); }
 
@@ -24,30 +23,29 @@ void MMU::updateSystem()
 	}
 }
 
-void MMU::reset()
+void MMU::reset(bool randomizeRAM)
 {
 	s = {};
 	gbc = {};
 	dmgCompatSwitch = false;
 
-	for (int i = 0; i < 0x2000; i++)
-		wramBanks[i] = RngOps::gen8bit();
+	if (!randomizeRAM)
+		return;
+
+	const std::span wram { wramBanks };
+	gb.rng.fill(wram.first(0x2000));
 
 	if (System::Current() == GBSystem::CGB)
 	{
 		// WRAM Bank 2 is zeroed instead.
-		for (int i = 0x2000; i < 0x3000; i++)
-			wramBanks[i] = 0;
-
-		for (int i = 0x3000; i < 0x8000; i++)
-			wramBanks[i] = RngOps::gen8bit();
+		std::ranges::fill(wram.subspan(0x2000, 0x1000), 0);
+		gb.rng.fill(wram.subspan(0x3000));
 	}
 
-	for (uint8_t& i : hram)
-		i = RngOps::gen8bit();
+	gb.rng.fill(hram);
 }
 
-void MMU::saveState(std::ostream& st) const
+void MMU::saveState(StateWriter& st) const
 {
 	ST_WRITE(s);
 
@@ -60,7 +58,7 @@ void MMU::saveState(std::ostream& st) const
 	ST_WRITE_ARR(hram);
 }
 
-void MMU::loadState(std::istream& st)
+void MMU::loadState(StateReader& st)
 {
 	ST_READ(s);
 
@@ -118,7 +116,7 @@ void MMU::executeDMA()
 		s.dma.delayCycles--;
 	else
 	{
-		gb.ppu->OAM[s.dma.cycles++] = (this->*readFunc)(s.dma.sourceAddr++);
+		gb.ppu->writeOAM(s.dma.cycles++, (this->*readFunc)(s.dma.sourceAddr++));
 
 		if (s.dma.restartRequest && s.dma.delayCycles-- == 0)
 		{
@@ -193,7 +191,7 @@ void MMU::write8(uint16_t addr, uint8_t val)
 	else if (addr <= 0xFE9F)
 	{
 		if (gb.ppu->canWriteOAM() && !dmaInProgress())
-			gb.ppu->OAM[addr - 0xFE00] = val;
+			gb.ppu->writeOAM(addr - 0xFE00, val);
 	}
 	else if (addr <= 0xFF7F)
 	{
@@ -400,6 +398,10 @@ void MMU::write8(uint16_t addr, uint8_t val)
 				gbc.FF75 = val;
 			break;
 		default:
+			// Bring the APU up to the current cycle, so the write takes effect at the right point in the output.
+			if (addr >= 0xFF10 && addr <= 0xFF3F)
+				gb.apu.sync();
+
 			// Audio registers are not writable when APU is disabled.
 			if (gb.apu.enabled())
 			{
@@ -473,9 +475,11 @@ void MMU::write8(uint16_t addr, uint8_t val)
 					break;
 				case 0xFF24:
 					gb.apu.regs.NR50 = val;
+					gb.apu.updateMixGains();
 					break;
 				case 0xFF25:
 					gb.apu.regs.NR51 = val;
+					gb.apu.updateMixGains();
 					break;
 				}
 			}
@@ -702,12 +706,18 @@ uint8_t MMU::read8(uint16_t addr) const
 				return 0xFF;
 		case 0xFF76:
 			if constexpr (System::IsCGBDevice(sys))
+			{
+				gb.apu.sync();
 				return gb.apu.readPCM12();
+			}
 			else
 				return 0xFF;
 		case 0xFF77:
 			if constexpr (System::IsCGBDevice(sys))
+			{
+				gb.apu.sync();
 				return gb.apu.readPCM34();
+			}
 			else
 				return 0xFF;
 
@@ -752,11 +762,14 @@ uint8_t MMU::read8(uint16_t addr) const
 		case 0xFF25: 
 			return gb.apu.regs.NR51;
 		case 0xFF26:
+			gb.apu.sync();
 			return gb.apu.getNR52();
 
 		default:
 			if (addr >= 0xFF30 && addr <= 0xFF3F)
 			{
+				gb.apu.sync();
+
 				if (gb.apu.channel3.s.enabled)
 				{
 					if (System::Current() == GBSystem::DMG)
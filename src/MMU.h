@@ -5,6 +5,7 @@
 #include <iostream>
 #include <functional>
 #include "gbSystem.h"
+#include "Utils/stateStream.h"
 
 class GBCore;
 class Cartridge;
@@ -24,10 +25,10 @@ public:
 	explicit MMU(GBCore& gbCore);
 
 	void updateSystem();
-	void reset();
+	void reset(bool randomizeRAM = true);
 
-	void saveState(std::ostream& st) const;
-	void loadState(std::istream& st);
+	void saveState(StateWriter& st) const;
+	void loadState(StateReader& st);
 
 	inline void write8(uint16_t addr, uint8_t val) { (this->*writeFunc)(addr, val); }
 	inline uint8_t read8(uint16_t addr) const { return (this->*readFunc)(addr); }
@@ -30,16 +30,16 @@ public:
 		return true;
 	}
 
-	void saveState(std::ostream& st) const override
+	void saveState(StateWriter& st) const override
 	{
 		ST_WRITE(s);
-		MBC::saveBattery(st);
+		writeRAM(st);
 		rtc.saveState(st);
 	}
-	void loadState(std::istream& st) override
+	void loadState(StateReader& st) override
 	{
 		ST_READ(s);
-		MBC::loadBattery(st);
+		readRAM(st, st.remaining());
 		rtc.loadState(st);
 	}
 
@@ -2,6 +2,7 @@
 #include <array>
 #include <cstdint>
 #include "../Utils/bitOps.h"
+#include "../Utils/stateStream.h"
 #include "RTC.h"
 
 struct Huc3RTCState
@@ -138,7 +139,7 @@ public:
 		return true;
 	}
 
-	void saveState(std::ostream& st)
+	void saveState(StateWriter& st)
 	{
 		updateTime();
 
@@ -146,7 +147,7 @@ public:
 		ST_WRITE(s);
 		ST_WRITE_ARR(regs);
 	}
-	void loadState(std::istream& st)
+	void loadState(StateReader& st)
 	{
 		ST_READ(lastUnixTime);
 		ST_READ(s);
@@ -4,7 +4,6 @@
 #include "MBCBase.h"
 #include "../defines.h"
 #include "../Utils/fileUtils.h"
-#include "../Utils/rngOps.h"
 #include "../Cartridge.h"
 
 struct MBCstate
@@ -33,35 +32,23 @@ public:
 
 	virtual void saveBattery(std::ostream& st) const override
 	{
-		if (cartridge.hasRAM)
-			st.write(reinterpret_cast<const char*>(ram.data()), ram.size());
+		writeRAM(st);
 	}
 	virtual bool loadBattery(std::istream& st) override
 	{
-		if (cartridge.hasRAM)
-		{
-			const uint32_t saveSize { FileUtils::remainingBytes(st) };
-
-			if (saveSize < ram.size())
-				return false;
-
-			st.read(reinterpret_cast<char*>(ram.data()), ram.size());
-			sramDirty = true;
-		}
-
-		return true;
+		return readRAM(st, FileUtils::remainingBytes(st));
 	}
 
-	void saveState(std::ostream& st) const override
+	void saveState(StateWriter& st) const override
 	{
 		ST_WRITE(s);
-		saveBattery(st);
+		writeRAM(st);
 	}
 
-	void loadState(std::istream& st) override
+	void loadState(StateReader& st) override
 	{
 		ST_READ(s);
-		loadBattery(st);
+		readRAM(st, st.remaining());
 	}
 
 	void reset(bool resetBattery) override
@@ -72,13 +59,34 @@ public:
 protected:
 	Cartridge& cartridge;
 
-	const std::vector<uint8_t>& rom;
+	const RomImage& rom;
 	std::vector<uint8_t>& ram;
 	T s;
 
+	// Shared by battery files and save states.
+	template <typename Stream>
+	void writeRAM(Stream& st) const
+	{
+		if (cartridge.hasRAM)
+			st.write(reinterpret_cast<const char*>(ram.data()), ram.size());
+	}
+	template <typename Stream>
+	bool readRAM(Stream& st, size_t availableBytes)
+	{
+		if (cartridge.hasRAM)
+		{
+			if (availableBytes < ram.size())
+				return false;
+
+			st.read(reinterpret_cast<char*>(ram.data()), ram.size());
+			sramDirty = true;
+		}
+
+		return true;
+	}
+
 	virtual void resetBatteryState()
 	{
-		for (uint8_t& i : ram)
-			i = RngOps::gen8bit();
+		cartridge.randomizeRAM();
 	}
 };
\ No newline at end of file
@@ -20,11 +20,11 @@ public:
 	{
 		if (addr <= 0x3FFF)
 		{
-			return rom[(addr + s.lowROMOffset) & (rom.size() - 1)];
+			return rom[(addr + s.lowROMOffset) & (cartridge.romBanks * 0x4000 - 1)];
 		}
 		if (addr <= 0x7FFF)
 		{
-			return rom[((addr & 0x3FFF) + s.highROMOffset) & (rom.size() - 1)];
+			return rom[((addr & 0x3FFF) + s.highROMOffset) & (cartridge.romBanks * 0x4000 - 1)];
 		}
 		if (addr <= 0xBFFF)
 		{
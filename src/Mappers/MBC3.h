@@ -22,21 +22,22 @@ public:
 
 	void saveBattery(std::ostream& st) const override
 	{
-		MBC::saveBattery(st);
-
-		if (rtc.has_value())
-		{
-			updateRTC();
-			rtc->saveBattery(st);
-		}
+		save(st);
 	}
 	bool loadBattery(std::istream& st) override
 	{
-		return load<false>(st);
+		return load<false>(st, FileUtils::remainingBytes(st));
+	}
+
+	void saveState(StateWriter& st) const override
+	{
+		ST_WRITE(s);
+		save(st);
 	}
-	void loadState(std::istream& st) override
+	void loadState(StateReader& st) override
 	{
-		load<true>(st);
+		ST_READ(s);
+		load<true>(st, st.remaining());
 	}
 
 	void reset(bool resetBattery) override
@@ -149,19 +150,28 @@ private:
 			rtc->reset();
 	}
 
-	template <bool saveState>
-	bool load(std::istream& st)
+	template <typename Stream>
+	void save(Stream& st) const
 	{
-		if constexpr (saveState)
-			ST_READ(s);
+		writeRAM(st);
 
-		if (!MBC::loadBattery(st))
+		if (rtc.has_value())
+		{
+			updateRTC();
+			rtc->saveBattery(st);
+		}
+	}
+
+	template <bool saveState, typename Stream>
+	bool load(Stream& st, size_t availableBytes)
+	{
+		if (!readRAM(st, availableBytes))
 			return false;
 
 		if (rtc.has_value())
 		{
 			lastRTCAccessCycles = cartridge.getGBCycles();
-			rtc->load<saveState>(st);
+			rtc->load<saveState>(st, cartridge.hasRAM ? availableBytes - ram.size() : availableBytes);
 		}
 
 		return true;
@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <iostream>
 #include "RTC.h"
+#include "../Utils/stateStream.h"
 
 struct MBCBase
 {
@@ -10,8 +11,8 @@ struct MBCBase
 	virtual uint8_t read(uint16_t addr) const = 0;
 	virtual void write(uint16_t addr, uint8_t val) = 0;
 
-	virtual void saveState(std::ostream& st) const = 0;
-	virtual void loadState(std::istream& st) = 0;
+	virtual void saveState(StateWriter& st) const = 0;
+	virtual void loadState(StateReader& st) = 0;
 
 	virtual void saveBattery(std::ostream& st) const = 0;
 	virtual bool loadBattery(std::istream& st) = 0;
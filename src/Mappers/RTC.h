@@ -1,5 +1,6 @@
 #pragma once
 #include <chrono>
+#include <cstdint>
 
 class RTC
 {
@@ -7,9 +8,26 @@ public:
 	virtual void enableFastForward(int speedFactor) {};
 	virtual void disableFastForward() {};
 
+	// Pinned clock reads 'unixTime' plus the emulated time instead of the wall clock, so runs replay identically (e.g. input movies).
+	inline void pinClock(uint64_t unixTime, const uint64_t* emulatedCycles)
+	{
+		pinnedTime = unixTime;
+		pinnedCycles = emulatedCycles;
+	}
+	inline void unpinClock() { pinnedCycles = nullptr; }
+
 protected:
 	inline uint64_t getUnixTime() const
 	{
+		if (pinnedCycles != nullptr)
+			return pinnedTime + *pinnedCycles / CLOCK_CYCLES_PER_SECOND;
+
 		return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 	}
-};
\ No newline at end of file
+
+private:
+	static constexpr uint64_t CLOCK_CYCLES_PER_SECOND = 1048576 * 4;
+
+	uint64_t pinnedTime { 0 };
+	const uint64_t* pinnedCycles { nullptr };
+};
@@ -133,7 +133,8 @@ public:
 		}
 	}
 
-	void saveBattery(std::ostream& st) const
+	template <typename Stream>
+	void saveBattery(Stream& st) const
 	{
 		const auto writeAs32 = [&st](uint32_t val)
 		{
@@ -155,19 +156,17 @@ public:
 		ST_WRITE(lastUnixTime);
 	}
 
-	template <bool saveState>
-	bool load(std::istream& st)
+	template <bool saveState, typename Stream>
+	bool load(Stream& st, size_t remainingBytes)
 	{
 		constexpr int MIN_RTC_SAVE_SIZE = 40;
 
-		uint32_t remainingBytes { FileUtils::remainingBytes(st) };
-
 		if (remainingBytes < MIN_RTC_SAVE_SIZE)
 			return false;
 
 		const auto readAs32 = [&st](uint8_t& val)
 		{
-			uint32_t val32;
+			uint32_t val32 { 0 };
 			ST_READ(val32);
 			val = static_cast<uint8_t>(val32);
 		};
@@ -6,6 +6,11 @@
 #include "keyBindManager.h"
 #include "debugUI.h"
 #include "resources.h"
+#include "audioRenderer.h"
+#include "stateBenchmark.h"
+#include "moviePlayer.h"
+#include "inputMovie.h"
+#include "rewindBuffer.h"
 #include "Utils/Shader.h"
 #include "Utils/fileUtils.h"
 #include "Utils/glFunctions.h"
@@ -69,7 +74,9 @@ Shader lcdShader{};
 Shader* currentShader{ };
 std::array<uint32_t, 2> gbTextures{};
 
-const std::vector<uint8_t> whiteBG(PPU::FRAMEBUFFER_SIZE, 255);
+// RGBA rows are 4 byte aligned and don't need swizzling by the driver on upload.
+constexpr PixelFormat GB_FRAMEBUFFER_FORMAT { PixelFormat::RGBA8888 };
+const std::vector<uint8_t> whiteBG(PPU::MAX_FRAMEBUFFER_SIZE, 255);
 
 bool glScreenshotRequested { false };
 bool fileDialogOpen { false };
@@ -78,7 +85,8 @@ bool fileDialogOpen { false };
 constexpr nfdnfilteritem_t openFilterItem[] { { N_STR("Game ROM/Save"), N_STR("gb,gbc,zip,sav,mbs,bin") } };
 constexpr nfdnfilteritem_t saveStateFilterItem[] { { N_STR("Save State"), N_STR("mbs") } };
 constexpr nfdnfilteritem_t batterySaveFilterItem[] { { N_STR("Battery Save"), N_STR("sav") } };
-constexpr nfdnfilteritem_t audioSaveFilterItem[] { { N_STR("WAV File"), N_STR("wav") } };
+constexpr nfdnfilteritem_t audioSaveFilterItem[] { { N_STR("FLAC File"), N_STR("flac") }, { N_STR("WAV File"), N_STR("wav") } };
+constexpr nfdnfilteritem_t movieFilterItem[] { { N_STR("Input Movie"), N_STR("mbm") } };
 #else
 constexpr const char* openFilterItem { ".gb,.gbc,.zip,.sav,.mbs,.bin" };
 
@@ -98,6 +106,11 @@ float fadeTime { 0.0f };
 bool fastForwarding { false }, fastForwardChangeFlag { false };
 constexpr int FAST_FORWARD_SPEED = 5;
 
+RewindBuffer rewindBuffer;
+bool rewinding { false };
+
+InputMovie movie;
+
 bool lockVSyncSetting { false };
 
 int awaitingKeyBind { -1 };
@@ -172,9 +185,15 @@ void setFastForwarding(bool val)
 	fastForwarding = val;
 	fastForwardChangeFlag = true;
 }
+void updateRewindSettings()
+{
+    rewindBuffer.setCapacity(appConfig::rewindEnabled ? static_cast<size_t>(appConfig::rewindBufferSize) * 1024 * 1024 : 0);
+    rewindBuffer.setInterval(appConfig::rewindInterval);
+}
 void resetRom(bool fullReset)
 {
     gb.resetRom(fullReset);
+    rewindBuffer.clear();
     updateColorCorrection(); // For hybrid GB/GBC roms, if user changed system preference then color correction setting may need to be updated.
     debugUI::signalROMreset();
 }
@@ -242,6 +261,7 @@ bool loadFile(std::istream& st, const std::filesystem::path& filePath)
     const auto handleFileSuccess = []() -> bool
     {
         showInfoPopUp = false;
+        rewindBuffer.clear();
         debugUI::signalROMreset();
         updateColorCorrection(); // If game changed from GB to GBC or GBC to GB.
         updateWindowTitle();
@@ -328,6 +348,7 @@ inline void loadState(int num)
 
     if (result == FileLoadResult::SuccessSaveState)
     {
+        rewindBuffer.clear();
         debugUI::signalSaveStateChange();
         updateColorCorrection(); // For hybrid GB/GBC roms, if user changed system preference then color correction setting may need to be updated.
         return;
@@ -344,23 +365,21 @@ inline void saveState(int num)
 		return;
 
     if (num == QUICK_SAVE_STATE)
-        gb.saveState(gb.getSaveStateFolderPath() / "quicksave.mbs");
+        gb.saveState(gb.getSaveStateFolderPath() / "quicksave.mbs", StateCodec::LZ4);
     else
     {
         gb.saveState(num);
         activateInfoPopUp("Save State Saved!");
     }
-
-    modifiedSaveStates[num] = true;
 }
 
 void takeScreenshot(bool captureOpenGL)
 {
 #ifdef EMSCRIPTEN // Emscripten only supports RGBA format for glReadPixels
-    const int CHANNELS = captureOpenGL ? 4 : 3;
+    constexpr int GL_CHANNELS = 4;
     constexpr int GL_FORMAT = GL_RGBA;
 #else
-    constexpr int CHANNELS = 3;
+    constexpr int GL_CHANNELS = 3;
     constexpr int GL_FORMAT = GL_RGB;
 #endif
 
@@ -368,7 +387,7 @@ void takeScreenshot(bool captureOpenGL)
 
     if (captureOpenGL)
     {
-        glFramebuffer = std::make_shared<uint8_t[]>(viewport_width * viewport_height * CHANNELS);
+        glFramebuffer = std::make_shared<uint8_t[]>(viewport_width * viewport_height * GL_CHANNELS);
 		glReadPixels(viewport_xOffset, viewport_yOffset, viewport_width, viewport_height, GL_FORMAT, GL_UNSIGNED_BYTE, glFramebuffer.get());
     }
 
@@ -377,9 +396,21 @@ void takeScreenshot(bool captureOpenGL)
         const int width { captureOpenGL ? viewport_width : PPU::SCR_WIDTH };
         const int height { captureOpenGL ? viewport_height : PPU::SCR_HEIGHT };
         const uint8_t* framebuffer { captureOpenGL ? glFramebuffer.get() : gb.ppu->framebufferPtr() };
+        int channels { captureOpenGL ? GL_CHANNELS : PixelOps::bytesPerPixel(GB_FRAMEBUFFER_FORMAT) };
+
+        // PNG writer only takes 8 bit channels.
+        std::vector<uint8_t> rgbFramebuffer;
+
+        if (!captureOpenGL && GB_FRAMEBUFFER_FORMAT == PixelFormat::RGB565)
+        {
+            rgbFramebuffer.resize(PPU::FRAMEBUFFER_SIZE);
+            PixelOps::convertBuffer(framebuffer, GB_FRAMEBUFFER_FORMAT, rgbFramebuffer.data(), PixelFormat::RGB888, width, height);
+            framebuffer = rgbFramebuffer.data();
+            channels = 3;
+        }
 
         size_t pngDataSize { 0 };
-        const auto pngBuffer { tdefl_write_image_to_png_file_in_memory_ex(framebuffer, width, height, CHANNELS, &pngDataSize, 3, captureOpenGL) };
+        const auto pngBuffer { tdefl_write_image_to_png_file_in_memory_ex(framebuffer, width, height, channels, &pngDataSize, 3, captureOpenGL) };
 
         if (!pngBuffer)
             return;
@@ -428,12 +459,24 @@ void resetFade()
     fadeEffectActive = false; 
 }
 
+// True when both gb textures hold the current ppu framebuffer, so identical frames don't need to be uploaded.
+bool gbTexturesSynced { false };
+
 void drawCallback(const uint8_t* framebuffer, bool firstFrame)
 {
-    OpenGL::updateTexture(gbTextures[0], PPU::SCR_WIDTH, PPU::SCR_HEIGHT, framebuffer);
+    const bool frameChanged { firstFrame || gb.ppu->framebufferChanged() };
+
+    if (!frameChanged && gbTexturesSynced)
+    {
+        debugUI::signalVBlank();
+        return;
+    }
+
+    gbTexturesSynced = !frameChanged || firstFrame;
+    OpenGL::updateTexture(gbTextures[0], PPU::SCR_WIDTH, PPU::SCR_HEIGHT, framebuffer, GB_FRAMEBUFFER_FORMAT);
 
     if (firstFrame)
-        OpenGL::updateTexture(gbTextures[1], PPU::SCR_WIDTH, PPU::SCR_HEIGHT, framebuffer);
+        OpenGL::updateTexture(gbTextures[1], PPU::SCR_WIDTH, PPU::SCR_HEIGHT, framebuffer, GB_FRAMEBUFFER_FORMAT);
     else
         std::swap(gbTextures[0], gbTextures[1]);
 
@@ -442,8 +485,10 @@ void drawCallback(const uint8_t* framebuffer, bool firstFrame)
 
 void clearGBTexture()
 {
+    gbTexturesSynced = false;
+
     for (auto t : gbTextures)
-        OpenGL::updateTexture(t, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, whiteBG.data());
+        OpenGL::updateTexture(t, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, whiteBG.data(), GB_FRAMEBUFFER_FORMAT);
 }
 
 void handleCartridgeUnload()
@@ -455,6 +500,12 @@ void handleCartridgeUnload()
         setFastForwarding(false);
     }
 
+    rewinding = false;
+    rewindBuffer.clear();
+
+    if (movie.isRecording())
+        movie.stopRecording(gb);
+
     updateWindowTitle();
     debugUI::signalROMreset(true);
 }
@@ -466,6 +517,12 @@ void bootRomExitCallback()
         clearGBTexture();
 }
 
+// Thumbnail is reloaded once the file is actually written.
+void stateSavedCallback(int saveNum)
+{
+    modifiedSaveStates[saveNum] = true;
+}
+
 // For new palette to be applied on screen even if emulation is paused.
 void refreshDMGPaletteColors(const std::array<color, 4>& newPalette) 
 {
@@ -475,7 +532,7 @@ void refreshDMGPaletteColors(const std::array<color, 4>& newPalette)
     gb.ppu->refreshDMGScreenColors(newPalette);
     
     for (auto t : gbTextures)
-        OpenGL::updateTexture(t, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, gb.ppu->framebufferPtr());
+        OpenGL::updateTexture(t, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, gb.ppu->framebufferPtr(), GB_FRAMEBUFFER_FORMAT);
 }
 void updateSelectedPalette()
 {
@@ -492,7 +549,7 @@ void setOpenGL()
     OpenGL::createQuad(VAO, VBO, EBO);
 
     for (auto& t : gbTextures)
-        OpenGL::createTexture(t, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, whiteBG.data(), appConfig::bilinearFiltering);
+        OpenGL::createTexture(t, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, whiteBG.data(), appConfig::bilinearFiltering, GB_FRAMEBUFFER_FORMAT);
 
     updateSelectedFilter();
     updateSelectedPalette(); 
@@ -599,15 +656,13 @@ void rescaleWindow()
 //}
 
 #ifndef EMSCRIPTEN
-std::filesystem::path saveFileDialog(const std::string& defaultName, const nfdnfilteritem_t* filter)
+std::filesystem::path saveFileDialog(const std::string& defaultName, std::span<const nfdnfilteritem_t> filters)
 {
-    APU::isMainThreadBlocked = true;
     fileDialogOpen = true;
 
     NFD::UniquePathN outPath;
-    const auto result { NFD::SaveDialog(outPath, filter, 1, nullptr, FileUtils::nativePathFromUTF8(defaultName).c_str()) };
+    const auto result { NFD::SaveDialog(outPath, filters.data(), static_cast<nfdfiltersize_t>(filters.size()), nullptr, FileUtils::nativePathFromUTF8(defaultName).c_str()) };
 
-    APU::isMainThreadBlocked = false;
     fileDialogOpen = false;
 
     return result == NFD_OKAY ? outPath.get() : std::filesystem::path();
@@ -615,13 +670,11 @@ std::filesystem::path saveFileDialog(const std::string& defaultName, const nfdnf
 
 std::filesystem::path openFileDialog(const nfdnfilteritem_t* filter)
 {
-    APU::isMainThreadBlocked = true;
     fileDialogOpen = true;
 
     NFD::UniquePathN outPath;
     const auto result { NFD::OpenDialog(outPath, filter, 1) };
 
-    APU::isMainThreadBlocked = false;
     fileDialogOpen = false;
 
     return result == NFD_OKAY ? outPath.get() : std::filesystem::path();
@@ -687,6 +740,45 @@ void emscriptenUpdateImGuiCursor()
 }
 #endif
 
+void startMovieRecording(InputMovie::StartPoint start)
+{
+    setFastForwarding(false);
+    rewinding = false;
+
+    if (!movie.startRecording(gb, start))
+    {
+        activateInfoPopUp("Failed to Start Recording!");
+        return;
+    }
+
+    if (start == InputMovie::StartPoint::PowerOn)
+    {
+        rewindBuffer.clear();
+        updateColorCorrection();
+        debugUI::signalROMreset();
+    }
+}
+void saveMovie()
+{
+    if (movie.frameCount() == 0)
+        return;
+
+    const std::string filename { gb.gameTitle + " - Movie.mbm" };
+#ifdef EMSCRIPTEN
+    std::ostringstream st;
+    movie.save(st);
+    downloadFile(st.view(), filename.c_str());
+#else
+    const auto result { saveFileDialog(filename, movieFilterItem) };
+
+    if (!result.empty())
+    {
+        std::ofstream st { result, std::ios::out | std::ios::binary };
+        movie.save(st);
+    }
+#endif
+}
+
 bool keyConfigWindowOpen { false };
 
 void renderKeyConfigGUI()
@@ -845,15 +937,18 @@ void renderSaveStatesGUI()
 
         if (modifiedSaveStates[i])
         {
-            static std::vector<uint8_t> framebuf(PPU::FRAMEBUFFER_SIZE);
+            constexpr uint32_t THUMBNAIL_WIDTH { SaveStateIndex::THUMBNAIL_WIDTH };
+            constexpr uint32_t THUMBNAIL_HEIGHT { SaveStateIndex::THUMBNAIL_HEIGHT };
+            static std::vector<uint8_t> thumbnail(THUMBNAIL_WIDTH * THUMBNAIL_HEIGHT * 4);
 
-            if (!gb.loadSaveStateThumbnail(saveStatePath, framebuf))
-                std::memset(framebuf.data(), 0, PPU::FRAMEBUFFER_SIZE);
+            if (!gb.loadSaveSlotThumbnail(i, thumbnail))
+                PixelOps::clearBuffer(thumbnail.data(), THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT, color { 0, 0, 0 }, GB_FRAMEBUFFER_FORMAT);
 
+            // Thumbnails are half resolution, filtered since they're drawn upscaled.
             if (saveStateTextures[i])
-                OpenGL::updateTexture(saveStateTextures[i], PPU::SCR_WIDTH, PPU::SCR_HEIGHT, framebuf.data());
+                OpenGL::updateTexture(saveStateTextures[i], THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT, thumbnail.data(), GB_FRAMEBUFFER_FORMAT);
             else
-                OpenGL::createTexture(saveStateTextures[i], PPU::SCR_WIDTH, PPU::SCR_HEIGHT, framebuf.data());
+                OpenGL::createTexture(saveStateTextures[i], THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT, thumbnail.data(), true, GB_FRAMEBUFFER_FORMAT);
 
             modifiedSaveStates[i] = false;
         }
@@ -947,7 +1042,10 @@ void renderSaveStatesGUI()
             {
                 // Instead of passing the number pass the path, so save state is just copied, without becoming the active one.
                 if (gb.loadState(saveStatePath) == FileLoadResult::SuccessSaveState)
+                {
+                    rewindBuffer.clear();
                     debugUI::signalSaveStateChange();
+                }
 
                 showSaveStatePopUp = false;
             }
@@ -1278,9 +1376,64 @@ void renderImGUI()
             if (ImGui::Checkbox("Battery Saves", &appConfig::batterySaves))
                 appConfig::updateConfigFile();
 
+            ImGui::BeginDisabled(!appConfig::batterySaves);
+
+            if (ImGui::Checkbox("Incremental Battery Writes", &appConfig::incrementalBatterySaves))
+                appConfig::updateConfigFile();
+
+            if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+                ImGui::SetTooltip("Only writes the parts of the save file that changed. Helps games that write to save RAM constantly.");
+
+            ImGui::EndDisabled();
+
             if (ImGui::Checkbox("Autosave Save Slot", &appConfig::autosaveState))
                 appConfig::updateConfigFile();
 
+            ImGui::SeparatorText("Input Latency");
+
+            ImGui::PushItemFlag(ImGuiItemFlags_NoTabStop, true);
+
+            if (ImGui::SliderInt("Run-Ahead Frames", &appConfig::runAheadFrames, 0, GBCore::MAX_RUN_AHEAD_FRAMES))
+                gb.setRunAheadFrames(appConfig::runAheadFrames);
+
+            if (ImGui::IsItemDeactivatedAfterEdit())
+                appConfig::updateConfigFile();
+
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Hides the game's own input lag. Needs more CPU, and too many frames can look jumpy.");
+
+            ImGui::PopItemFlag();
+
+            ImGui::SeparatorText("Rewind");
+
+            if (ImGui::Checkbox("Enable Rewind", &appConfig::rewindEnabled))
+            {
+                updateRewindSettings();
+                appConfig::updateConfigFile();
+            }
+
+            if (appConfig::rewindEnabled)
+            {
+                ImGui::PushItemFlag(ImGuiItemFlags_NoTabStop, true);
+
+                if (ImGui::SliderInt("Buffer (MB)", &appConfig::rewindBufferSize, appConfig::MIN_REWIND_BUFFER_SIZE, appConfig::MAX_REWIND_BUFFER_SIZE))
+                    updateRewindSettings();
+
+                if (ImGui::IsItemDeactivatedAfterEdit())
+                    appConfig::updateConfigFile();
+
+                if (ImGui::SliderInt("Frames per Snapshot", &appConfig::rewindInterval, appConfig::MIN_REWIND_INTERVAL, appConfig::MAX_REWIND_INTERVAL))
+                    updateRewindSettings();
+
+                if (ImGui::IsItemDeactivatedAfterEdit())
+                    appConfig::updateConfigFile();
+
+                ImGui::PopItemFlag();
+
+                const std::string usageText { std::to_string(rewindBuffer.usedBytes() / 1024) + " KB used, " + std::to_string(rewindBuffer.snapshotCount()) + " snapshots" };
+                ImGui::Text("%s", usageText.c_str());
+            }
+
             ImGui::SeparatorText("Controls");
 
             if (ImGui::Button("Key Binding"))
@@ -1457,18 +1610,21 @@ void renderImGUI()
             if (ImGui::Checkbox("Enable Audio", &appConfig::enableAudio))
                 appConfig::updateConfigFile();
 
-            static int volume { static_cast<int>(gb.apu.volume * 100) };
+            if (ImGui::Checkbox("Sync to Audio", &appConfig::audioSync))
+                appConfig::updateConfigFile();
+
+            static int volume { static_cast<int>(gb.apu.getVolume() * 100) };
 
             ImGui::PushItemFlag(ImGuiItemFlags_NoTabStop, true);
 
             if (ImGui::SliderInt("Volume", &volume, 0, 100))
-                gb.apu.volume = static_cast<float>(volume / 100.0);
+                gb.apu.setVolume(static_cast<float>(volume / 100.0));
 
             ImGui::PopItemFlag();
 
             ImGui::SeparatorText("Misc.");
 
-            if (gb.apu.isRecording)
+            if (gb.apu.isRecording())
             {
                 if (ImGui::Button("Stop Recording"))
                 {
@@ -1482,8 +1638,8 @@ void renderImGUI()
 
                 ImGui::SameLine();
 
-                const auto minutes { static_cast<int>(gb.apu.recordedSeconds) / 60 };
-                const auto seconds { static_cast<int>(gb.apu.recordedSeconds) % 60 };
+                const auto minutes { static_cast<int>(gb.apu.recordedSeconds()) / 60 };
+                const auto seconds { static_cast<int>(gb.apu.recordedSeconds()) % 60 };
                 ImGui::Text("%d:%02d", minutes, seconds);
             }
             else
@@ -1551,6 +1707,28 @@ void renderImGUI()
 
                 if (ImGui::MenuItem("Enter Cheat"))
                     cheatsWindowOpen = true;
+
+                if (gb.canSaveStateNow())
+                {
+                    if (movie.isRecording())
+                    {
+                        if (ImGui::MenuItem("Stop Recording Movie"))
+                        {
+                            movie.stopRecording(gb);
+                            saveMovie();
+                        }
+                    }
+                    else if (ImGui::BeginMenu("Record Movie"))
+                    {
+                        if (ImGui::MenuItem("From Power-On", "Warning!"))
+                            startMovieRecording(InputMovie::StartPoint::PowerOn);
+
+                        if (ImGui::MenuItem("From Here"))
+                            startMovieRecording(InputMovie::StartPoint::SaveState);
+
+                        ImGui::EndMenu();
+                    }
+                }
             }
 
             if (!gb.cartridge.loaded())
@@ -1607,11 +1785,21 @@ void renderImGUI()
                 ImGui::Separator();
                 ImGui::Text("Emulation Paused");
             }
+            else if (rewinding)
+            {
+                ImGui::Separator();
+                ImGui::Text("Rewind...");
+            }
             else if (fastForwarding)
             {
                 ImGui::Separator();
                 ImGui::Text("Fast Forward...");
             }
+            else if (movie.isRecording())
+            {
+                ImGui::Separator();
+                ImGui::Text("Recording Movie: %llu", static_cast<unsigned long long>(movie.frameCount()));
+            }
             else if (gb.cartridge.loaded() && gb.getSaveNum() != 0)
             {
                 const std::string saveText { "Save: " + std::to_string(gb.getSaveNum()) };
@@ -1816,6 +2004,10 @@ void key_callback(GLFWwindow* _window, int key, int scancode, int action, int mo
 
     if (key == KeyBindManager::getBind(MegaBoyKey::FastForward))
     {
+        // Movies are recorded frame by frame at normal speed.
+        if (movie.isRecording())
+            return;
+
         if (action == GLFW_PRESS)
             setFastForwarding(true);
 		else if (action == GLFW_RELEASE)
@@ -1824,6 +2016,12 @@ void key_callback(GLFWwindow* _window, int key, int scancode, int action, int mo
         return;
     }
 
+    if (key == KeyBindManager::getBind(MegaBoyKey::Rewind))
+    {
+        rewinding = action == GLFW_PRESS && !movie.isRecording();
+        return;
+    }
+
     gb.joypad.update(key, action == GLFW_PRESS);
 }
 
@@ -2096,6 +2294,8 @@ void mainLoop()
     const double deltaTime { std::clamp(currentTime - lastFrameTime, 0.0, MAX_DELTA_TIME) };
     lastFrameTime = currentTime;
 
+    gb.pollFileWrites();
+
     secondsTimer += deltaTime;
     gbTimer += deltaTime;
 
@@ -2105,6 +2305,17 @@ void mainLoop()
         fastForwardChangeFlag = false;
     }
 
+    // When synced to audio, emulation runs whenever the audio device is missing a frame worth of samples instead of by the timer.
+    // Otherwise the APU resamples slightly to follow the timer.
+    const bool audioPaced { appConfig::audioSync && appConfig::enableAudio && gb.apu.deviceRunning && !fastForwarding && !rewinding && emulationRunning() };
+    gb.apu.dynamicRateControl = appConfig::enableAudio && !audioPaced;
+
+    if (audioPaced)
+    {
+        const double missingFrames { static_cast<double>(APU::TARGET_BUFFERED_FRAMES) - static_cast<double>(gb.apu.bufferedFrames()) };
+        gbTimer = std::max(missingFrames, 0.0) / APU::SAMPLE_RATE;
+    }
+
     const bool shouldRender { appConfig::vsync || gbTimer >= GBCore::FRAME_RATE };
 
     if (shouldRender)
@@ -2146,10 +2357,25 @@ void mainLoop()
         if (emulationRunning())
 		{
             const auto execStart { glfwGetTime() };
-            APU::lastMainThreadTime = execStart;
-            
-            gb.emulateFrame();
-            
+
+            if (rewinding)
+            {
+                // Two frames, so the presented one is fully drawn after the restored snapshot.
+                if (rewindBuffer.rewindStep(gb))
+                {
+                    gb.emulateFrame();
+                    gb.emulateFrame();
+                }
+            }
+            else
+            {
+                gb.emulateFrame();
+                rewindBuffer.onFrame(gb);
+
+                if (movie.isRecording() && !movie.recordFrame(gb))
+                    saveMovie(); // A state was loaded or the game was reset, the recording ends before it.
+            }
+
             gbExecuteTimes += (glfwGetTime() - execStart);
             gbFrameCount++;
             numUpdates++;
@@ -2183,13 +2409,8 @@ void mainLoop()
         gbFpsText = oss.str();
 
         if (emulationRunning())
-        {
             gb.autoSave();
 
-            if (appConfig::autosaveState && gb.getSaveNum() != 0)
-                modifiedSaveStates[gb.getSaveNum()] = true;
-        }
-
         frameCount = 0;
         frameTimes = 0;
         gbFrameCount = 0;
@@ -2207,7 +2428,12 @@ void runApp(int argc, char* argv[])
     appConfig::loadConfigFile();
 
     gb.setDrawCallback(drawCallback);
+    gb.setFramebufferFormat(GB_FRAMEBUFFER_FORMAT);
     gb.setBootRomExitCallback(bootRomExitCallback);
+    gb.setStateSavedCallback(stateSavedCallback);
+    gb.apu.initAudioDevice();
+    gb.setRunAheadFrames(appConfig::runAheadFrames);
+    updateRewindSettings();
 
     setGLFW();
     setOpenGL();
@@ -2257,8 +2483,19 @@ int main(int argc, char* argv[])
         });
     });
 #else
+    if (argc > 1 && argv[1] == AudioRenderer::CLI_FLAG)
+        return AudioRenderer::run(argc, argv);
+
+    if (argc > 1 && argv[1] == StateBenchmark::CLI_FLAG)
+        return StateBenchmark::run(argc, argv);
+
+    if (argc > 1 && argv[1] == MoviePlayer::CLI_FLAG)
+        return MoviePlayer::run(argc, argv);
+
     runApp(argc, argv);
     gb.autoSave();
+    gb.waitForFileWrites();
+    debugUI::shutdown();
 
     NFD_Quit();
     ImGui_ImplOpenGL3_Shutdown();
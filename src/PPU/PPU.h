@@ -5,15 +5,19 @@
 #include <iostream>
 #include <memory>
 #include <functional>
+#include <bitset>
+#include <algorithm>
 #include <random>
 
 #include "../gbSystem.h"
+#include "../Utils/stateStream.h"
 #include "../defines.h"
 #include "../Utils/pixelOps.h"
 #include "../Utils/bitOps.h"
 #include "../Utils/rngOps.h"
 
 using color = PixelOps::color;
+using PixelFormat = PixelOps::PixelFormat;
 
 enum class PPUMode : uint8_t
 {
@@ -98,7 +102,7 @@ struct PixelFIFO
 		clear();
 	}
 
-	inline void saveState(std::ostream& st) const
+	inline void saveState(StateWriter& st) const
 	{
 		ST_WRITE(s);
 		ST_WRITE(front);
@@ -106,7 +110,7 @@ struct PixelFIFO
 		ST_WRITE(size);
 		ST_WRITE_ARR(data);
 	}
-	inline void loadState(std::istream& st)
+	inline void loadState(StateReader& st)
 	{
 		ST_READ(s);
 		ST_READ(front);
@@ -166,7 +170,8 @@ struct gbcPaletteData
 	static constexpr std::array<uint8_t, 16> DEFAULT_DMG_COMPAT_OBJ { 255, 127, 31, 66, 242, 28, 0, 0, 255, 127, 31, 66, 242, 28, 0, 0 };
 
 	// BCPS (bg) palette is set to white by default (0xFF -> 0x7F pattern, bit 7 of first byte is zero), OCPS (obj) is random.
-	inline void reset(bool obj)
+	// Without randomizeRAM OBJ palette RAM is left as is, like the other RAM when a state is about to overwrite it.
+	inline void reset(bool obj, RngOps::Xoshiro256& rng, bool randomizeRAM)
 	{
 		int i = 0;
 
@@ -176,8 +181,16 @@ struct gbcPaletteData
 			i = obj ? 16 : 8;
 		}
 
-		for (; i < RAM.size(); i++)
-			RAM[i] = obj ? RngOps::gen8bit() : ((i & 1) == 0 ? 0xFF : 0x7F);
+		if (obj)
+		{
+			if (randomizeRAM)
+				rng.fill(std::span { RAM }.subspan(i));
+		}
+		else
+		{
+			for (; i < RAM.size(); i++)
+				RAM[i] = (i & 1) == 0 ? 0xFF : 0x7F;
+		}
 
 		// When CGB Boot ROM ends, OCPS register is 1. 
 		regValue = obj ? 1 : 0;
@@ -206,13 +219,13 @@ struct gbcPaletteData
 		regValue = autoIncrement ? ((regValue + 1) & 0x3F) : regValue;
 	}
 
-	inline void loadState(std::istream& st)
+	inline void loadState(StateReader& st)
 	{
 		ST_READ_ARR(RAM);
 		ST_READ(regValue);
 		ST_READ(autoIncrement);
 	}
-	inline void saveState(std::ostream& st) const
+	inline void saveState(StateWriter& st) const
 	{
 		ST_WRITE_ARR(RAM);
 		ST_WRITE(regValue);
@@ -226,20 +239,20 @@ struct ppuGBCRegs
 	gbcPaletteData BCPS{};
 	gbcPaletteData OCPS{};
 
-	inline void reset()
+	inline void reset(RngOps::Xoshiro256& rng, bool randomizeRAM)
 	{
 		VBK = 0xFE;
-		BCPS.reset(false);
-		OCPS.reset(true);
+		BCPS.reset(false, rng, randomizeRAM);
+		OCPS.reset(true, rng, randomizeRAM);
 	}
 
-	inline void saveState(std::ostream& st) const
+	inline void saveState(StateWriter& st) const
 	{
 		ST_WRITE(VBK);
 		BCPS.saveState(st);
 		OCPS.saveState(st);
 	}
-	inline void loadState(std::istream& st)
+	inline void loadState(StateReader& st)
 	{
 		ST_READ(VBK);
 		BCPS.loadState(st);
@@ -269,7 +282,10 @@ class PPU
 public:
 	static constexpr uint8_t SCR_WIDTH = 160;
 	static constexpr uint8_t SCR_HEIGHT = 144;
-	static constexpr uint32_t FRAMEBUFFER_SIZE = SCR_WIDTH * SCR_HEIGHT * 3;
+	static constexpr uint32_t FRAMEBUFFER_SIZE = SCR_WIDTH * SCR_HEIGHT * 3; // RGB888, used by debug views and save state thumbnails.
+	static constexpr uint32_t MAX_FRAMEBUFFER_SIZE = SCR_WIDTH * SCR_HEIGHT * 4;
+
+	static constexpr uint32_t framebufferSize(PixelFormat format) { return SCR_WIDTH * SCR_HEIGHT * PixelOps::bytesPerPixel(format); }
 
 	static constexpr uint16_t TILES_WIDTH = 16 * 8;
 	static constexpr uint16_t TILES_HEIGHT = 24 * 8;
@@ -294,21 +310,63 @@ public:
 	std::function<void(const uint8_t*, bool)> drawCallback { nullptr };
 
 	virtual void execute() = 0;
-	virtual void reset(bool clearBuf) = 0;
+	virtual void reset(bool clearBuf, bool randomizeRAM) = 0;
 
 	virtual void setLCDEnable(bool val) = 0;
 
-	virtual void saveState(std::ostream& st) const = 0;
-	virtual void loadState(std::istream& st) = 0;
+	virtual void saveState(StateWriter& st) const = 0;
+	virtual void loadState(StateReader& st) = 0;
 
 	virtual void refreshDMGScreenColors(const std::array<color, 4>& newColorPalette) = 0;
 
 	virtual void renderTileData(uint8_t* buffer, int vramBank) = 0;
 	virtual void renderTileMap(uint8_t* buffer, uint16_t addr) = 0;
 
+	// Copy of VRAM, OAM, palettes and registers which debug views can render from on another thread.
+	virtual std::unique_ptr<PPU> createDebugSnapshot() const = 0;
+
+	inline void updateDebugSnapshot(PPU& snapshot) const
+	{
+		snapshot.VRAM_BANK0 = VRAM_BANK0;
+		snapshot.VRAM_BANK1 = VRAM_BANK1;
+		snapshot.OAM = OAM;
+		snapshot.BGP = BGP;
+		snapshot.OBP0 = OBP0;
+		snapshot.OBP1 = OBP1;
+		snapshot.regs = regs;
+		snapshot.gbcRegs = gbcRegs;
+	}
+
+	// Scanlines of the last presented frame that differ from the frame presented before it.
+	inline const std::bitset<SCR_HEIGHT>& changedScanlines() const { return presentedChangedLines; }
+	inline bool framebufferChanged() const { return presentedChangedLines.any(); }
+	inline void markFramebufferChanged() { presentedChangedLines.set(); }
+
+	inline PixelFormat getFramebufferFormat() const { return framebufferFormat; }
+	inline uint32_t framebufferSize() const { return framebufferSize(framebufferFormat); }
+
+	inline void setFramebufferFormat(PixelFormat format)
+	{
+		if (format == framebufferFormat)
+			return;
+
+		for (auto* buf : { &framebuffer, &backbuffer })
+		{
+			auto converted { std::make_unique<uint8_t[]>(MAX_FRAMEBUFFER_SIZE) };
+			PixelOps::convertBuffer(buf->get(), framebufferFormat, converted.get(), format, SCR_WIDTH, SCR_HEIGHT);
+			*buf = std::move(converted);
+		}
+
+		framebufferFormat = format;
+	}
+
 	inline uint8_t* framebufferPtr() { return framebuffer.get(); }
 	inline uint8_t* backbufferPtr() { return backbuffer.get(); }
 
+	// Frames started while render skip is enabled keep exact timing, but don't compose pixels and aren't presented.
+	inline void setRenderSkip(bool val) { renderSkipEnabled = val; }
+	inline bool frameRenderSkipped() const { return skipFrameRender; }
+
 	inline uint8_t* oamFramebuffer() { return debugOAMFramebuffer.get(); }
 	inline uint8_t* bgFramebuffer() { return debugBGFramebuffer.get(); }
 	inline uint8_t* windowFramebuffer() { return debugWindowFramebuffer.get(); }
@@ -325,8 +383,9 @@ public:
 		}
 	}
 protected:
-	std::unique_ptr<uint8_t[]> framebuffer { std::make_unique<uint8_t[]>(FRAMEBUFFER_SIZE) };
-	std::unique_ptr<uint8_t[]> backbuffer { std::make_unique<uint8_t[]>(FRAMEBUFFER_SIZE) };
+	PixelFormat framebufferFormat { PixelFormat::RGB888 };
+	std::unique_ptr<uint8_t[]> framebuffer { std::make_unique<uint8_t[]>(MAX_FRAMEBUFFER_SIZE) };
+	std::unique_ptr<uint8_t[]> backbuffer { std::make_unique<uint8_t[]>(MAX_FRAMEBUFFER_SIZE) };
 
 	std::array<uint8_t, 160> OAM{};
 	std::array<uint8_t, 8192> VRAM_BANK0{};
@@ -341,6 +400,9 @@ protected:
 	uint8_t objCount{ 0 };
 	std::array<OAMobject, 10> selectedObjects{};
 
+	// Bit N is set if OAM object N can be on the line (assuming 8x16 size), so OAM search doesn't need to check all 40 objects.
+	std::array<uint64_t, SCR_HEIGHT> oamLineMasks{};
+
 	ppuDMGRegs regs{};
 	ppuGBCRegs gbcRegs{};
 
@@ -348,6 +410,12 @@ protected:
 	BGPixelFIFO bgFIFO{};
 	ObjPixelFIFO objFIFO{};
 
+	std::bitset<SCR_HEIGHT> changedLines{};
+	std::bitset<SCR_HEIGHT> presentedChangedLines{};
+
+	bool renderSkipEnabled { false };
+	bool skipFrameRender { false };
+
 	bool debugPPU { false };
 	std::unique_ptr<uint8_t[]> debugOAMFramebuffer{};
 	std::unique_ptr<uint8_t[]> debugBGFramebuffer{};
@@ -359,6 +427,32 @@ protected:
 		return (regs.STAT & (~0b11)) | static_cast<uint8_t>(s.prevState);
 	}
 
+	inline void updateOAMIndex(uint8_t objInd, uint8_t oldY, uint8_t newY)
+	{
+		const uint64_t objBit { 1ULL << objInd };
+
+		for (int line = std::max(oldY - 16, 0); line < std::min<int>(oldY, SCR_HEIGHT); line++)
+			oamLineMasks[line] &= ~objBit;
+
+		for (int line = std::max(newY - 16, 0); line < std::min<int>(newY, SCR_HEIGHT); line++)
+			oamLineMasks[line] |= objBit;
+	}
+	inline void rebuildOAMIndex()
+	{
+		oamLineMasks.fill(0);
+
+		for (uint8_t i = 0; i < sizeof(OAM) / 4; i++)
+			updateOAMIndex(i, 0, OAM[i * 4]);
+	}
+
+	inline void writeOAM(uint8_t addr, uint8_t val)
+	{
+		if ((addr & 0x3) == 0 && OAM[addr] != val)
+			updateOAMIndex(addr / 4, OAM[addr], val);
+
+		OAM[addr] = val;
+	}
+
 	inline static void updatePalette(uint8_t val, std::array<uint8_t, 4>& palette)
 	{
 		for (uint8_t i = 0; i < 4; i++)
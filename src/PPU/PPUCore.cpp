@@ -1,6 +1,7 @@
 #include <iostream>
 #include <algorithm>
 #include <cstring>
+#include <bit>
 
 #include "PPUCore.h"
 #include "../GBCore.h"
@@ -11,19 +12,22 @@ template class PPUCore<GBSystem::CGB>;
 template class PPUCore<GBSystem::DMGCompatMode>;
 
 template <GBSystem sys>
-void PPUCore<sys>::reset(bool clearBuf)
+void PPUCore<sys>::reset(bool clearBuf, bool randomizeRAM)
 {
 	std::memset(OAM.data(), 0, sizeof(OAM));
+	rebuildOAMIndex();
 	std::memset(VRAM_BANK0.data(), 0, sizeof(VRAM_BANK0));
 	VRAM = VRAM_BANK0.data();
 
 	s = {};
 	regs = {};
+	skipFrameRender = false;
+	statInputsCache = -1;
 
 	if constexpr (System::IsCGBDevice(sys))
 	{
 		std::memset(VRAM_BANK1.data(), 0, sizeof(VRAM_BANK1));
-		gbcRegs.reset();
+		gbcRegs.reset(rng, randomizeRAM);
 	}
 	if constexpr (sys != GBSystem::CGB)
 		updatePalette(regs.BGP, this->BGP);
@@ -36,7 +40,7 @@ void PPUCore<sys>::reset(bool clearBuf)
 }
 
 template <GBSystem s>
-void PPUCore<s>::saveState(std::ostream& st) const
+void PPUCore<s>::saveState(StateWriter& st) const
 {
 	ST_WRITE(regs);
 	ST_WRITE(s);
@@ -71,10 +75,11 @@ void PPUCore<s>::saveState(std::ostream& st) const
 }
 
 template <GBSystem s>
-void PPUCore<s>::loadState(std::istream& st)
+void PPUCore<s>::loadState(StateReader& st)
 {
 	ST_READ(regs);
 	ST_READ(s);
+	statInputsCache = -1;
 
 	const auto sys { System::Current() };
 
@@ -84,6 +89,8 @@ void PPUCore<s>::loadState(std::istream& st)
 
 		if (sys == GBSystem::CGB)
 			ST_READ_ARR(VRAM_BANK1);
+
+		setVRAMBank(gbcRegs.VBK & 0x1);
 	}
 	if (sys != GBSystem::CGB)
 	{
@@ -94,6 +101,7 @@ void PPUCore<s>::loadState(std::istream& st)
 
 	ST_READ_ARR(VRAM_BANK0);
 	ST_READ_ARR(OAM);
+	rebuildOAMIndex();
 
 	if (s.state == PPUMode::PixelTransfer)
 	{
@@ -113,13 +121,19 @@ void PPUCore<sys>::refreshDMGScreenColors(const std::array<color, 4>& newColorPa
 	if constexpr (sys != GBSystem::DMG) 
 		return;
 
+	// Compare against colors as stored in the framebuffer, since lower precision formats don't keep the exact palette values.
+	std::array<color, 4> storedColors;
+
+	for (int i = 0; i < 4; i++)
+		storedColors[i] = PixelOps::quantize(PPU::ColorPalette[i], framebufferFormat);
+
 	for (uint8_t y = 0; y < SCR_HEIGHT; y++)
 	{
 		for (uint8_t x = 0; x < SCR_WIDTH; x++)
 		{
 			const color pixel { getPixel(x, y) };
-			const uint8_t pixelInd { static_cast<uint8_t>(std::find(PPU::ColorPalette, PPU::ColorPalette + 4, pixel) - PPU::ColorPalette) };
-			PixelOps::setPixel(framebuffer.get(), SCR_WIDTH, x, y, newColorPalette[pixelInd]);
+			const uint8_t pixelInd { static_cast<uint8_t>(std::find(storedColors.begin(), storedColors.end(), pixel) - storedColors.begin()) };
+			PixelOps::setPixel(framebuffer.get(), SCR_WIDTH, x, y, newColorPalette[pixelInd & 0x3], framebufferFormat);
 		}
 	}
 }
@@ -140,6 +154,7 @@ void PPUCore<sys>::setLCDEnable(bool val)
 		s.videoCycles = 0;
 		s.hblankCycles = OAM_SCAN_CYCLES - 4;
 		s.dotsUntilVBlank = GBCore::CYCLES_PER_FRAME - TOTAL_VBLANK_CYCLES - 4;
+		skipFrameRender = renderSkipEnabled;
 		updateInterrupts();
 	}
 	else
@@ -179,12 +194,14 @@ template <GBSystem sys>
 void PPUCore<sys>::updateInterrupts()
 {
 	bool interrupt { false };
+	bool lycChecked { true };
 
 	// For 1M cycle after hblank is over and LY is incremented, lyc flag is forced to false.
 	if (s.lyIncremented) [[unlikely]]
 	{
 		regs.STAT = resetBit(regs.STAT, 2);
 		s.lyIncremented = false;
+		lycChecked = false;
 	}
 	else
 	{
@@ -219,6 +236,8 @@ void PPUCore<sys>::updateInterrupts()
 	}
 	else
 		s.blockStat = false;
+
+	statInputsCache = lycChecked ? currentStatInputs() : -1;
 }
 
 template <GBSystem sys>
@@ -304,21 +323,28 @@ void PPUCore<sys>::execute()
 		}
 	};
 
-	tick();
-	tick();
+	uint8_t dots { 4 };
 
 	if constexpr (sys == GBSystem::CGB)
 	{
-		if (!cpu.doubleSpeedMode())
-		{
-			tick();
-			tick();
-		}
+		if (cpu.doubleSpeedMode())
+			dots = 2;
+	}
+
+	// Outside of pixel transfer nothing happens until mode's dot counter reaches its end, so the whole M-cycle can be advanced at once.
+	if (s.videoCycles + dots < modeEndCycles()) [[likely]]
+	{
+		s.videoCycles += dots;
+		s.dotsUntilVBlank -= dots;
+
+		// STAT interrupt line can only change if LYC or STAT were written since the last full update.
+		if (statInputsCache == currentStatInputs())
+			return;
 	}
 	else
 	{
-		tick();
-		tick();
+		for (uint8_t i = 0; i < dots; i++)
+			tick();
 	}
 
 	updateInterrupts();
@@ -378,8 +404,20 @@ void PPUCore<sys>::handleOAMSearch()
 		s.videoCycles -= OAM_SCAN_CYCLES;
 		objCount = 0;
 
-		for (uint8_t oamAddr = 0; oamAddr < sizeof(OAM) && objCount < 10; oamAddr += 4)
+		// Keeps objects sorted by X as they are selected. Objects with same X stay in OAM order.
+		const auto selectObject = [&](const OAMobject& obj)
+		{
+			uint8_t ind { objCount++ };
+
+			for (; ind > 0 && selectedObjects[ind - 1].X > obj.X; ind--)
+				selectedObjects[ind] = selectedObjects[ind - 1];
+
+			selectedObjects[ind] = obj;
+		};
+
+		for (uint64_t objMask { oamLineMasks[s.LY] }; objMask != 0 && objCount < 10; objMask &= objMask - 1)
 		{
+			const uint8_t oamAddr { static_cast<uint8_t>(std::countr_zero(objMask) * 4) };
 			const int16_t objY { static_cast<int16_t>(OAM[oamAddr] - 16) };
 			const int16_t objX { static_cast<int16_t>(OAM[oamAddr + 1] - 8) };
 			const uint8_t tileInd { OAM[oamAddr + 2] };
@@ -389,25 +427,23 @@ void PPUCore<sys>::handleOAMSearch()
 			if (!DoubleOBJSize())
 			{
 				if (s.LY >= objY && s.LY < objY + 8)
-					selectedObjects[objCount++] = OAMobject{ objX, objY, static_cast<uint16_t>(tileInd * 16), attributes, oamAddr };
+					selectObject(OAMobject{ objX, objY, static_cast<uint16_t>(tileInd * 16), attributes, oamAddr });
 			}
 			else
 			{
 				if (s.LY >= objY && s.LY < objY + 8)
 				{
 					const uint16_t tileAddr = yFlip ? ((tileInd & 0xFE) + 1) * 16 : (tileInd & 0xFE) * 16;
-					selectedObjects[objCount++] = OAMobject{ objX, objY, tileAddr, attributes, oamAddr };
+					selectObject(OAMobject{ objX, objY, tileAddr, attributes, oamAddr });
 				}
 				else if (s.LY >= objY + 8 && s.LY < objY + 16)
 				{
 					const uint16_t tileAddr = yFlip ? (tileInd & 0xFE) * 16 : ((tileInd & 0xFE) + 1) * 16;
-					selectedObjects[objCount++] = OAMobject{ objX, static_cast<int16_t>(objY + 8), tileAddr, attributes, oamAddr };
+					selectObject(OAMobject{ objX, static_cast<int16_t>(objY + 8), tileAddr, attributes, oamAddr });
 				}
 			}
 		}
 
-		std::stable_sort(selectedObjects.begin(), selectedObjects.begin() + objCount, [](const auto& a, const auto& b) { return a.X < b.X; });
-
 		SetPPUMode(PPUMode::PixelTransfer);
 	}
 }
@@ -432,6 +468,7 @@ void PPUCore<sys>::handleVBlank()
 			break;
 		case 1:
 			s.LY = 0;
+			skipFrameRender = renderSkipEnabled;
 			SetPPUMode(PPUMode::OAMSearch);
 			break;
 		default:
@@ -475,6 +512,7 @@ void PPUCore<sys>::handlePixelTransfer()
 
 		if (s.xPosCounter == SCR_WIDTH) [[unlikely]]
 		{
+			if (!skipFrameRender) updateChangedLine();
 			SetPPUMode(PPUMode::HBlank);
 			s.videoCycles = 0;
 		}
@@ -712,6 +750,13 @@ void PPUCore<sys>::renderFIFOs()
 		return;
 	}
 
+	if (skipFrameRender) [[unlikely]]
+	{
+		if (!objFIFO.empty()) objFIFO.pop();
+		s.xPosCounter++;
+		return;
+	}
+
 	if constexpr (sys != GBSystem::CGB)
 		if (!DMGTileMapsEnable()) bg.color = 0;
 
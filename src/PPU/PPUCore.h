@@ -1,6 +1,7 @@
 #pragma once
 #include <array>
 #include <vector>
+#include <cstring>
 
 #include "PPU.h"
 #include "../MMU.h"
@@ -11,21 +12,29 @@ template <GBSystem sys>
 class PPUCore final : public PPU
 {
 public:
-	PPUCore(MMU& mmu, CPU& cpu) : mmu(mmu), cpu(cpu) { }
+	PPUCore(MMU& mmu, CPU& cpu, RngOps::Xoshiro256& rng) : mmu(mmu), cpu(cpu), rng(rng) { }
 
 	void execute() override;
-	void reset(bool clearBuf) override;
+	void reset(bool clearBuf, bool randomizeRAM) override;
 
-	void saveState(std::ostream& st) const override;
-	void loadState(std::istream& st) override;
+	void saveState(StateWriter& st) const override;
+	void loadState(StateReader& st) override;
 
 	void refreshDMGScreenColors(const std::array<color, 4>& newColors) override;
 
 	void renderTileMap(uint8_t* buffer, uint16_t addr) override;
 	void renderTileData(uint8_t* buffer, int vramBank) override;
+
+	inline std::unique_ptr<PPU> createDebugSnapshot() const override
+	{
+		auto snapshot { std::make_unique<PPUCore<sys>>(mmu, cpu, rng) };
+		updateDebugSnapshot(*snapshot);
+		return snapshot;
+	}
 private:
 	MMU& mmu;
 	CPU& cpu;
+	RngOps::Xoshiro256& rng;
 
 	static constexpr uint16_t TOTAL_SCANLINE_CYCLES = 456;
 	static constexpr uint16_t OAM_SCAN_CYCLES = 20 * 4;
@@ -34,7 +43,11 @@ private:
 
 	inline void invokeDrawCallback(bool firstFrame = false) 
 	{
-		std::swap(framebuffer, backbuffer);
+		if (!skipFrameRender) [[likely]]
+		{
+			std::swap(framebuffer, backbuffer);
+			presentedChangedLines = changedLines;
+		}
 
 		if (drawCallback != nullptr)
 			drawCallback(framebuffer.get(), firstFrame);
@@ -42,10 +55,30 @@ private:
 
 	inline void clearBuffer(bool firstFrame = false)
 	{
-		PixelOps::clearBuffer(backbuffer.get(), SCR_WIDTH, SCR_HEIGHT, sys == GBSystem::DMG ? PPU::ColorPalette[0] : color { 255, 255, 255 });
+		PixelOps::clearBuffer(backbuffer.get(), SCR_WIDTH, SCR_HEIGHT, sys == GBSystem::DMG ? PPU::ColorPalette[0] : color { 255, 255, 255 }, framebufferFormat);
+		changedLines.set();
 		invokeDrawCallback(firstFrame);
 	}
 
+	// Dot count at which the current mode handler does something, pixel transfer does work on every dot.
+	inline uint16_t modeEndCycles() const
+	{
+		switch (s.state)
+		{
+		case PPUMode::HBlank:
+			return s.hblankCycles;
+		case PPUMode::VBlank:
+			return s.vblankLineCycles;
+		case PPUMode::OAMSearch:
+			return OAM_SCAN_CYCLES;
+		default:
+			return 0;
+		}
+	}
+
+	int32_t statInputsCache { -1 };
+	inline int32_t currentStatInputs() const { return regs.LYC << 8 | regs.STAT; }
+
 	void updateInterrupts();
 	void SetPPUMode(PPUMode ppuState);
 	void setLCDEnable(bool val) override;
@@ -67,8 +100,15 @@ private:
 	void executeObjFetcher();
 	void renderFIFOs();
 
-	constexpr color getPixel(uint8_t x, uint8_t y) const { return PixelOps::getPixel(framebuffer.get(), SCR_WIDTH, x, y); }
-	constexpr void setPixel(uint8_t x, uint8_t y, color c) { PixelOps::setPixel(backbuffer.get(), SCR_WIDTH, x, y, c); }
+	inline void updateChangedLine()
+	{
+		const uint32_t lineSize { static_cast<uint32_t>(SCR_WIDTH * PixelOps::bytesPerPixel(framebufferFormat)) };
+		const uint32_t offset { s.LY * lineSize };
+		changedLines[s.LY] = std::memcmp(backbuffer.get() + offset, framebuffer.get() + offset, lineSize) != 0;
+	}
+
+	inline color getPixel(uint8_t x, uint8_t y) const { return PixelOps::getPixel(framebuffer.get(), SCR_WIDTH, x, y, framebufferFormat); }
+	inline void setPixel(uint8_t x, uint8_t y, color c) { PixelOps::setPixel(backbuffer.get(), SCR_WIDTH, x, y, c, framebufferFormat); }
 
 	constexpr uint8_t getColorID(uint8_t tileLow, uint8_t tileHigh, uint8_t ind) const
 	{
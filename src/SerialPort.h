@@ -3,6 +3,7 @@
 #include <iostream>
 #include "CPU/CPU.h"
 #include "defines.h"
+#include "Utils/stateStream.h"
 
 class SerialPort
 {
@@ -18,8 +19,8 @@ public:
 
 	inline void reset() { s = {}; }
 
-	void saveState(std::ostream& st) const { ST_WRITE(s);}
-	void loadState(std::istream& st) { ST_READ(s); }
+	void saveState(StateWriter& st) const { ST_WRITE(s);}
+	void loadState(StateReader& st) { ST_READ(s); }
 private:
 	CPU& cpu;
 
@@ -0,0 +1,136 @@
+#include <fstream>
+#include "asyncFileWriter.h"
+#include "fileUtils.h"
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+	{
+		std::lock_guard lock { mutex };
+		stopRequested = true;
+	}
+
+	jobAvailable.notify_one();
+
+	// Remaining jobs are still written before the thread exits.
+	if (writerThread.joinable())
+		writerThread.join();
+}
+
+void AsyncFileWriter::submit(std::filesystem::path path, WriteFunc write, CompletionFunc onComplete)
+{
+	queueJob({ std::move(path), std::move(write), {}, std::move(onComplete) });
+}
+void AsyncFileWriter::submitTask(TaskFunc task, CompletionFunc onComplete)
+{
+	queueJob({ {}, {}, std::move(task), std::move(onComplete) });
+}
+
+void AsyncFileWriter::queueJob(Job job)
+{
+#ifdef EMSCRIPTEN
+	// No threads, write right away.
+	const bool success { job.task ? job.task() : writeFile(job.path, job.write) };
+
+	if (job.onComplete)
+		completed.emplace_back(std::move(job.onComplete), success);
+#else
+	{
+		std::lock_guard lock { mutex };
+		jobs.push_back(std::move(job));
+
+		// Started on first use, most sessions never save anything.
+		if (!writerThread.joinable())
+			writerThread = std::thread([this] { writerLoop(); });
+	}
+
+	jobAvailable.notify_one();
+#endif
+}
+
+void AsyncFileWriter::flush()
+{
+	std::unique_lock lock { mutex };
+	jobsDone.wait(lock, [this] { return jobs.empty() && !writing; });
+}
+
+void AsyncFileWriter::dispatchCompletions()
+{
+	std::vector<std::pair<CompletionFunc, bool>> finished;
+
+	{
+		std::lock_guard lock { mutex };
+
+		if (completed.empty())
+			return;
+
+		finished.swap(completed);
+	}
+
+	for (const auto& [onComplete, success] : finished)
+		onComplete(success);
+}
+
+void AsyncFileWriter::writerLoop()
+{
+	std::unique_lock lock { mutex };
+
+	while (true)
+	{
+		jobAvailable.wait(lock, [this] { return !jobs.empty() || stopRequested; });
+
+		if (jobs.empty())
+			break;
+
+		Job job { std::move(jobs.front()) };
+		jobs.pop_front();
+		writing = true;
+
+		lock.unlock();
+		const bool success { job.task ? job.task() : writeFile(job.path, job.write) };
+		lock.lock();
+
+		writing = false;
+
+		if (job.onComplete)
+			completed.emplace_back(std::move(job.onComplete), success);
+
+		if (jobs.empty())
+			jobsDone.notify_all();
+	}
+}
+
+bool AsyncFileWriter::writeFile(const std::filesystem::path& path, const WriteFunc& write, bool sync)
+{
+	auto tempPath { path };
+	tempPath += ".tmp";
+
+	{
+		std::ofstream st { tempPath, std::ios::out | std::ios::binary };
+
+		if (st)
+		{
+			write(st);
+			st.flush();
+		}
+
+		st.close();
+
+		if (st.fail() || (sync && !FileUtils::syncFile(tempPath)))
+		{
+			std::error_code err;
+			std::filesystem::remove(tempPath, err);
+			return false;
+		}
+	}
+
+	std::error_code err;
+	std::filesystem::rename(tempPath, path, err);
+
+	if (err)
+	{
+		std::filesystem::remove(tempPath, err);
+		return false;
+	}
+
+	return !sync || FileUtils::syncDirectory(path.parent_path());
+}
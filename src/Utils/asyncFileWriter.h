@@ -0,0 +1,60 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Writes files on a background thread, so saving doesn't stall emulation. Jobs are written in the order they were submitted.
+// Each file is written to a temporary file next to it first, then renamed over the destination, so it's never left half written.
+class AsyncFileWriter
+{
+public:
+	// Called on the writer thread to produce the file contents, so expensive work (like compression) should be done here.
+	using WriteFunc = std::function<void(std::ostream&)>;
+	using CompletionFunc = std::function<void(bool success)>;
+	// For updates that aren't a whole new file, e.g. writing into an existing one. Returns false on failure.
+	using TaskFunc = std::function<bool()>;
+
+	~AsyncFileWriter();
+
+	void submit(std::filesystem::path path, WriteFunc write, CompletionFunc onComplete = {});
+	// Runs the task on the writer thread, ordered with the other jobs.
+	void submitTask(TaskFunc task, CompletionFunc onComplete = {});
+
+	// Blocks until every submitted file is written. Completion callbacks are still left for dispatchCompletions.
+	void flush();
+
+	// Runs completion callbacks of finished jobs on the calling thread.
+	void dispatchCompletions();
+
+	// Writes a file through a temporary one right away, on the calling thread.
+	// With sync, the file and its directory entry are flushed to disk before returning, not just to the OS.
+	static bool writeFile(const std::filesystem::path& path, const WriteFunc& write, bool sync = false);
+
+private:
+	struct Job
+	{
+		std::filesystem::path path;
+		WriteFunc write;
+		TaskFunc task;
+		CompletionFunc onComplete;
+	};
+
+	void queueJob(Job job);
+	void writerLoop();
+
+	std::thread writerThread;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobsDone;
+
+	std::deque<Job> jobs;
+	std::vector<std::pair<CompletionFunc, bool>> completed;
+
+	bool writing { false };
+	bool stopRequested { false };
+};
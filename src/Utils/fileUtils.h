@@ -10,6 +10,7 @@
 #include "Windows.h"
 #elif defined(__linux__) || defined(__unix__) || defined(__APPLE__)
 #include <unistd.h>
+#include <fcntl.h>
 #endif
 
 #ifdef __APPLE__
@@ -83,6 +84,42 @@ namespace FileUtils
 		return static_cast<uint32_t>(availableBytes);
 	}
 
+    // Flushes a written file from the OS cache to the disk. Streams only flush to the OS, which can lose the data on a power cut.
+    inline bool syncFile(const std::filesystem::path& path)
+    {
+    #if defined(EMSCRIPTEN)
+        return true;
+    #elif defined(_WIN32)
+        const HANDLE file { CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        const bool success { FlushFileBuffers(file) != 0 };
+        CloseHandle(file);
+        return success;
+    #else
+        const int fd { open(path.c_str(), O_RDONLY) };
+
+        if (fd == -1)
+            return false;
+
+        const bool success { fsync(fd) == 0 };
+        close(fd);
+        return success;
+    #endif
+    }
+
+    // Flushes directory entries, e.g. to make a rename durable. Windows doesn't need (or allow) it.
+    inline bool syncDirectory(const std::filesystem::path& path)
+    {
+    #if defined(EMSCRIPTEN) || defined(_WIN32)
+        return true;
+    #else
+        return syncFile(path.empty() ? "." : path);
+    #endif
+    }
+
 #ifndef EMSCRIPTEN
     inline std::filesystem::path getExecutablePath() 
     {
@@ -8,6 +8,25 @@
 #include <glad/glad.h>
 #endif
 
+struct glPixelFormat
+{
+    int format;
+    int type;
+};
+
+static glPixelFormat getGLPixelFormat(PixelOps::PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelOps::PixelFormat::RGBA8888:
+        return { GL_RGBA, GL_UNSIGNED_BYTE };
+    case PixelOps::PixelFormat::RGB565:
+        return { GL_RGB, GL_UNSIGNED_SHORT_5_6_5 };
+    default:
+        return { GL_RGB, GL_UNSIGNED_BYTE };
+    }
+}
+
 void OpenGL::setTextureScalingMode(uint32_t textureId, bool bilinear)
 {
     bindTexture(textureId);
@@ -16,21 +35,24 @@ void OpenGL::setTextureScalingMode(uint32_t textureId, bool bilinear)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, scaleMode);
 }
 
-void OpenGL::createTexture(uint32_t& textureId, uint32_t width, uint32_t height, const uint8_t* data, bool bilinearFilter)
+void OpenGL::createTexture(uint32_t& textureId, uint32_t width, uint32_t height, const uint8_t* data, bool bilinearFilter, PixelOps::PixelFormat format)
 {
     glGenTextures(1, &textureId);
     glBindTexture(GL_TEXTURE_2D, textureId);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+    const auto glFormat { getGLPixelFormat(format) };
+    glTexImage2D(GL_TEXTURE_2D, 0, glFormat.format, width, height, 0, glFormat.format, glFormat.type, data);
     glGenerateMipmap(GL_TEXTURE_2D);
 
     setTextureScalingMode(textureId, bilinearFilter);
 }
 
-void OpenGL::updateTexture(uint32_t textureId, uint32_t width, uint32_t height, const uint8_t* data)
+void OpenGL::updateTexture(uint32_t textureId, uint32_t width, uint32_t height, const uint8_t* data, PixelOps::PixelFormat format)
 {
     glBindTexture(GL_TEXTURE_2D, textureId);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, data);
+
+    const auto glFormat { getGLPixelFormat(format) };
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, glFormat.format, glFormat.type, data);
 }
 void OpenGL::bindTexture(uint32_t textureId)
 {
@@ -1,11 +1,12 @@
 #pragma once
 #include <cstdint>
+#include "pixelOps.h"
 
 namespace OpenGL
 {
 	void createQuad(uint32_t& VAO, uint32_t& VBO, uint32_t& EBO);
-	void createTexture(uint32_t& textureId, uint32_t width, uint32_t height, const uint8_t* data = nullptr, bool bilinearFilter = false);
+	void createTexture(uint32_t& textureId, uint32_t width, uint32_t height, const uint8_t* data = nullptr, bool bilinearFilter = false, PixelOps::PixelFormat format = PixelOps::PixelFormat::RGB888);
 	void bindTexture(uint32_t textureId);
-	void updateTexture(uint32_t textureId, uint32_t width, uint32_t height, const uint8_t* data);
+	void updateTexture(uint32_t textureId, uint32_t width, uint32_t height, const uint8_t* data, PixelOps::PixelFormat format = PixelOps::PixelFormat::RGB888);
 	void setTextureScalingMode(uint32_t textureId, bool bilinear);
 }
\ No newline at end of file
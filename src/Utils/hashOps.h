@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <span>
+
+namespace HashOps
+{
+	inline uint64_t fnv1a(std::span<const uint8_t> data)
+	{
+		constexpr uint64_t FNV_PRIME = 0x100000001b3;
+		uint64_t hash { 0xcbf29ce484222325 };
+
+		for (const auto byte : data)
+		{
+			hash ^= byte;
+			hash *= FNV_PRIME;
+		}
+
+		return hash;
+	}
+
+	// Reference xxHash64. Input is consumed 32 bytes at a time in 4 independent lanes, so it runs at several GB/s without SIMD.
+	inline uint64_t xxHash64(std::span<const uint8_t> data, uint64_t seed = 0)
+	{
+		constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87;
+		constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4F;
+		constexpr uint64_t PRIME3 = 0x165667B19E3779F9;
+		constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63;
+		constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5;
+
+		const auto read64 = [](const uint8_t* ptr) { uint64_t val; std::memcpy(&val, ptr, sizeof(val)); return val; };
+		const auto read32 = [](const uint8_t* ptr) { uint32_t val; std::memcpy(&val, ptr, sizeof(val)); return val; };
+
+		const auto round = [](uint64_t acc, uint64_t input) { return std::rotl(acc + input * PRIME2, 31) * PRIME1; };
+		const auto mergeRound = [&](uint64_t acc, uint64_t val) { return (acc ^ round(0, val)) * PRIME1 + PRIME4; };
+
+		const uint8_t* ptr { data.data() };
+		const uint8_t* const end { data.data() + data.size() };
+		uint64_t hash;
+
+		if (data.size() >= 32)
+		{
+			uint64_t v1 { seed + PRIME1 + PRIME2 }, v2 { seed + PRIME2 }, v3 { seed }, v4 { seed - PRIME1 };
+
+			do
+			{
+				v1 = round(v1, read64(ptr));
+				v2 = round(v2, read64(ptr + 8));
+				v3 = round(v3, read64(ptr + 16));
+				v4 = round(v4, read64(ptr + 24));
+				ptr += 32;
+			}
+			while (end - ptr >= 32);
+
+			hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+			hash = mergeRound(hash, v1);
+			hash = mergeRound(hash, v2);
+			hash = mergeRound(hash, v3);
+			hash = mergeRound(hash, v4);
+		}
+		else
+			hash = seed + PRIME5;
+
+		hash += data.size();
+
+		for (; end - ptr >= 8; ptr += 8)
+			hash = std::rotl(hash ^ round(0, read64(ptr)), 27) * PRIME1 + PRIME4;
+
+		if (end - ptr >= 4)
+		{
+			hash = std::rotl(hash ^ (read32(ptr) * PRIME1), 23) * PRIME2 + PRIME3;
+			ptr += 4;
+		}
+
+		for (; ptr < end; ptr++)
+			hash = std::rotl(hash ^ (*ptr * PRIME5), 11) * PRIME1;
+
+		hash ^= hash >> 33;
+		hash *= PRIME2;
+		hash ^= hash >> 29;
+		hash *= PRIME3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+}
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <fstream>
+#include <string_view>
+#include "incrementalFile.h"
+#include "asyncFileWriter.h"
+#include "hashOps.h"
+#include "stateStream.h"
+#include "fileUtils.h"
+#include "../defines.h"
+
+// JOURNAL FORMAT (LITTLE ENDIAN):
+// 23 byte signature, 8 byte xxHash64 of everything after it, 8 byte size of the target file, 4 byte page count,
+// 4 byte index of each page, then the page contents back to back (the last page of the file can be shorter).
+
+namespace
+{
+	constexpr std::string_view JOURNAL_SIGNATURE = "MegaBoy Page Journal v1";
+
+	constexpr size_t pageLength(uint32_t page, uint64_t fileSize)
+	{
+		const uint64_t offset { static_cast<uint64_t>(page) * IncrementalFile::PAGE_SIZE };
+		return offset >= fileSize ? 0 : static_cast<size_t>(std::min<uint64_t>(IncrementalFile::PAGE_SIZE, fileSize - offset));
+	}
+}
+
+std::filesystem::path IncrementalFile::journalPath(const std::filesystem::path& path)
+{
+	auto journal { path };
+	journal += ".journal";
+	return journal;
+}
+
+IncrementalFile::Update IncrementalFile::makeUpdate(const std::filesystem::path& path, std::span<const uint8_t> image)
+{
+	Update update { path, {}, {}, image.size(), false, writeFailed };
+
+	if (path != lastPath || image.size() != lastImage.size() || lastImage.empty() || writeFailed->load())
+	{
+		update.full = true;
+		update.data.assign(image.begin(), image.end());
+	}
+	else
+	{
+		const auto pageCount { static_cast<uint32_t>((image.size() + PAGE_SIZE - 1) / PAGE_SIZE) };
+
+		for (uint32_t page = 0; page < pageCount; page++)
+		{
+			const auto pageData { image.subspan(page * PAGE_SIZE, pageLength(page, image.size())) };
+
+			if (!std::ranges::equal(pageData, std::span { lastImage }.subspan(page * PAGE_SIZE, pageData.size())))
+			{
+				update.pages.push_back(page);
+				update.data.insert(update.data.end(), pageData.begin(), pageData.end());
+			}
+		}
+	}
+
+	lastPath = path;
+	lastImage.assign(image.begin(), image.end());
+	return update;
+}
+
+bool IncrementalFile::write(const Update& update)
+{
+	if (update.full)
+	{
+		const bool success { writeFull(update.path, update.data) };
+		update.failed->store(!success);
+		return success;
+	}
+
+	if (update.pages.empty())
+		return true;
+
+	if (update.failed->load())
+		return false;
+
+	std::vector<uint8_t> journalData(sizeof(update.fileSize) + sizeof(uint32_t) + update.pages.size() * sizeof(uint32_t) + update.data.size());
+
+	{
+		StateWriter st { journalData };
+		const auto pageCount { static_cast<uint32_t>(update.pages.size()) };
+
+		ST_WRITE(update.fileSize);
+		ST_WRITE(pageCount);
+		st.write(reinterpret_cast<const char*>(update.pages.data()), update.pages.size() * sizeof(uint32_t));
+		st.write(reinterpret_cast<const char*>(update.data.data()), update.data.size());
+	}
+
+	// Journal has to be on disk before the pages are written in place, it's the only complete copy of them until then.
+	const bool journalWritten { AsyncFileWriter::writeFile(journalPath(update.path), [&](std::ostream& st)
+	{
+		const uint64_t hash { HashOps::xxHash64(journalData) };
+
+		st.write(JOURNAL_SIGNATURE.data(), JOURNAL_SIGNATURE.length());
+		ST_WRITE(hash);
+		st.write(reinterpret_cast<const char*>(journalData.data()), journalData.size());
+	}, true) };
+
+	if (!journalWritten || !writePages(update.path, update.fileSize, update.pages, update.data))
+	{
+		update.failed->store(true);
+		return false;
+	}
+
+	discardJournal(update.path);
+	return true;
+}
+
+bool IncrementalFile::writeFull(const std::filesystem::path& path, std::span<const uint8_t> data)
+{
+	const bool success { AsyncFileWriter::writeFile(path, [&](std::ostream& st)
+	{
+		st.write(reinterpret_cast<const char*>(data.data()), data.size());
+	}, true) };
+
+	if (success)
+		discardJournal(path);
+
+	return success;
+}
+
+void IncrementalFile::discardJournal(const std::filesystem::path& path)
+{
+	std::error_code err;
+	std::filesystem::remove(journalPath(path), err);
+}
+
+bool IncrementalFile::writePages(const std::filesystem::path& path, uint64_t fileSize, std::span<const uint32_t> pages, std::span<const uint8_t> data)
+{
+	std::error_code err;
+
+	if (std::filesystem::file_size(path, err) != fileSize || err)
+		return false;
+
+	std::fstream st { path, std::ios::in | std::ios::out | std::ios::binary };
+
+	if (!st)
+		return false;
+
+	size_t dataPos { 0 };
+
+	for (const uint32_t page : pages)
+	{
+		const size_t length { pageLength(page, fileSize) };
+
+		if (length == 0 || data.size() - dataPos < length)
+			return false;
+
+		st.seekp(static_cast<std::streamoff>(page) * PAGE_SIZE);
+		st.write(reinterpret_cast<const char*>(data.data() + dataPos), length);
+		dataPos += length;
+	}
+
+	st.close();
+
+	// Journal is only removed after this, so the pages must be on disk.
+	return !st.fail() && FileUtils::syncFile(path);
+}
+
+void IncrementalFile::recover(const std::filesystem::path& path)
+{
+	const auto journal { journalPath(path) };
+	std::ifstream ifs { journal, std::ios::in | std::ios::binary };
+
+	if (!ifs)
+		return;
+
+	std::vector<uint8_t> buffer(FileUtils::remainingBytes(ifs));
+	ifs.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+	ifs.close();
+
+	StateReader st { buffer };
+
+	std::string signature(JOURNAL_SIGNATURE.length(), 0);
+	uint64_t hash { 0 };
+
+	st.read(signature.data(), signature.length());
+	ST_READ(hash);
+
+	// Journal is only complete if the hash matches, otherwise the file wasn't touched yet.
+	if (st.good() && signature == JOURNAL_SIGNATURE && HashOps::xxHash64(st.remainingData()) == hash)
+	{
+		uint64_t fileSize { 0 };
+		uint32_t pageCount { 0 };
+
+		ST_READ(fileSize);
+		ST_READ(pageCount);
+
+		if (st.good() && pageCount <= st.remaining() / sizeof(uint32_t))
+		{
+			std::vector<uint32_t> pages(pageCount);
+			st.read(reinterpret_cast<char*>(pages.data()), pages.size() * sizeof(uint32_t));
+
+			if (st.good())
+				writePages(path, fileSize, pages, st.remainingData());
+		}
+	}
+
+	discardJournal(path);
+}
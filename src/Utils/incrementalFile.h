@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <span>
+#include <filesystem>
+
+// Keeps a file in sync with an in-memory image by only writing the pages that changed since the last update.
+// Changed pages go to a journal file first and are then written in place, so an interrupted update can be finished by recover().
+class IncrementalFile
+{
+public:
+	static constexpr size_t PAGE_SIZE = 256;
+
+	struct Update
+	{
+		std::filesystem::path path;
+		std::vector<uint32_t> pages; // Indices of the changed pages.
+		std::vector<uint8_t> data; // Their contents back to back, or the whole image if 'full'.
+		uint64_t fileSize { 0 };
+		bool full { false };
+
+		// Set when an update of the file fails. Until a full update succeeds, later updates are based on contents the file doesn't have.
+		std::shared_ptr<std::atomic<bool>> failed;
+
+		inline bool empty() const { return !full && pages.empty(); }
+	};
+
+	// Changes of the image since the last update. The first update of a path, one after a size change or after a failed write rewrites the whole file.
+	Update makeUpdate(const std::filesystem::path& path, std::span<const uint8_t> image);
+
+	// Forgets the last image, e.g. when the file was changed by something else.
+	inline void invalidate() { lastImage.clear(); }
+
+	// Applies an update to the file. Blocking, meant for the file writer thread.
+	// Page updates queued after a failed one fail too, without touching the file.
+	static bool write(const Update& update);
+
+	// Finishes an update that was interrupted after its journal was written, and removes a stale journal.
+	static void recover(const std::filesystem::path& path);
+
+	// Rewrites the whole file. Its journal is removed, otherwise recover() would apply old pages over the new contents.
+	static bool writeFull(const std::filesystem::path& path, std::span<const uint8_t> data);
+	static void discardJournal(const std::filesystem::path& path);
+
+private:
+	static std::filesystem::path journalPath(const std::filesystem::path& path);
+	static bool writePages(const std::filesystem::path& path, uint64_t fileSize, std::span<const uint32_t> pages, std::span<const uint8_t> data);
+
+	std::filesystem::path lastPath;
+	std::vector<uint8_t> lastImage;
+	std::shared_ptr<std::atomic<bool>> writeFailed { std::make_shared<std::atomic<bool>>(false) };
+};
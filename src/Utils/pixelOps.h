@@ -7,6 +7,26 @@
 
 namespace PixelOps
 {
+	enum class PixelFormat : uint8_t
+	{
+		RGB888,
+		RGBA8888,
+		RGB565
+	};
+
+	constexpr uint8_t bytesPerPixel(PixelFormat format)
+	{
+		switch (format)
+		{
+		case PixelFormat::RGBA8888:
+			return 4;
+		case PixelFormat::RGB565:
+			return 2;
+		default:
+			return 3;
+		}
+	}
+
 	struct color
 	{
 	public:
@@ -54,6 +74,24 @@ namespace PixelOps
 			return color { R, G, B };
 		}
 
+		constexpr uint16_t toRGB565() const
+		{
+			return static_cast<uint16_t>((R >> 3) << 11 | (G >> 2) << 5 | (B >> 3));
+		}
+		static constexpr color fromRGB565(uint16_t rgb565)
+		{
+			const uint8_t r5 = (rgb565 >> 11) & 0x1F;
+			const uint8_t g6 = (rgb565 >> 5) & 0x3F;
+			const uint8_t b5 = rgb565 & 0x1F;
+
+			return color
+			{
+				static_cast<uint8_t>((r5 << 3) | (r5 >> 2)),
+				static_cast<uint8_t>((g6 << 2) | (g6 >> 4)),
+				static_cast<uint8_t>((b5 << 3) | (b5 >> 2))
+			};
+		}
+
 		static inline color fromHex(std::string hexStr)
 		{
 			if (hexStr[0] == '#')
@@ -127,4 +165,89 @@ namespace PixelOps
 			buffer[i + 2] = c.B;
 		}
 	}
+
+	inline void setPixel(uint8_t* buffer, int width, int x, int y, color c, PixelFormat format)
+	{
+		switch (format)
+		{
+		case PixelFormat::RGB888:
+			setPixel(buffer, width, x, y, c);
+			break;
+		case PixelFormat::RGBA8888:
+		{
+			uint8_t* pixel { buffer + (y * width + x) * 4 };
+			pixel[0] = c.R;
+			pixel[1] = c.G;
+			pixel[2] = c.B;
+			pixel[3] = 255;
+			break;
+		}
+		case PixelFormat::RGB565:
+		{
+			const uint16_t rgb565 { c.toRGB565() };
+			std::memcpy(buffer + (y * width + x) * 2, &rgb565, sizeof(rgb565));
+			break;
+		}
+		}
+	}
+	inline color getPixel(const uint8_t* buffer, int width, int x, int y, PixelFormat format)
+	{
+		switch (format)
+		{
+		case PixelFormat::RGBA8888:
+		{
+			const uint8_t* pixel { buffer + (y * width + x) * 4 };
+			return color { pixel[0], pixel[1], pixel[2] };
+		}
+		case PixelFormat::RGB565:
+		{
+			uint16_t rgb565;
+			std::memcpy(&rgb565, buffer + (y * width + x) * 2, sizeof(rgb565));
+			return color::fromRGB565(rgb565);
+		}
+		default:
+			return getPixel(buffer, width, x, y);
+		}
+	}
+
+	// Color as it reads back after being stored in the given format.
+	constexpr color quantize(color c, PixelFormat format)
+	{
+		return format == PixelFormat::RGB565 ? color::fromRGB565(c.toRGB565()) : c;
+	}
+
+	inline void clearBuffer(uint8_t* buffer, int width, int height, color c, PixelFormat format)
+	{
+		if (!buffer)
+			return;
+
+		if (format == PixelFormat::RGB888)
+		{
+			clearBuffer(buffer, width, height, c);
+			return;
+		}
+
+		for (int i = 0; i < width; i++)
+			setPixel(buffer, width, i, 0, c, format);
+
+		const size_t lineSize { static_cast<size_t>(width) * bytesPerPixel(format) };
+
+		for (int y = 1; y < height; y++)
+			std::memcpy(buffer + y * lineSize, buffer, lineSize);
+	}
+
+	inline void convertBuffer(const uint8_t* src, PixelFormat srcFormat, uint8_t* dest, PixelFormat destFormat, int width, int height)
+	{
+		if (srcFormat == destFormat)
+		{
+			std::memcpy(dest, src, static_cast<size_t>(width) * height * bytesPerPixel(srcFormat));
+			return;
+		}
+
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+				setPixel(dest, width, x, y, getPixel(src, width, x, y, srcFormat), destFormat);
+		}
+	}
 }
\ No newline at end of file
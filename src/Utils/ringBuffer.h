@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+// Lock-free single producer / single consumer ring buffer. Capacity must be a power of two.
+template <typename T, size_t capacity>
+class RingBuffer
+{
+	static_assert((capacity & (capacity - 1)) == 0, "Ring buffer capacity must be a power of two.");
+	static constexpr size_t MASK = capacity - 1;
+
+public:
+	static constexpr size_t Capacity() { return capacity; }
+
+	// Can be called from both threads, result is only a snapshot.
+	inline size_t size() const
+	{
+		return writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire);
+	}
+	inline size_t freeSpace() const { return capacity - size(); }
+
+	// Producer side. Returns the number of elements actually written, rest is dropped if buffer is full.
+	size_t push(const T* data, size_t count)
+	{
+		const size_t write { writePos.load(std::memory_order_relaxed) };
+		const size_t read { readPos.load(std::memory_order_acquire) };
+
+		count = std::min(count, capacity - (write - read));
+		copyIn(write & MASK, data, count);
+
+		writePos.store(write + count, std::memory_order_release);
+		return count;
+	}
+
+	// Consumer side. Returns the number of elements actually read.
+	size_t pop(T* data, size_t count)
+	{
+		const size_t read { readPos.load(std::memory_order_relaxed) };
+		const size_t write { writePos.load(std::memory_order_acquire) };
+
+		count = std::min(count, write - read);
+		copyOut(read & MASK, data, count);
+
+		readPos.store(read + count, std::memory_order_release);
+		return count;
+	}
+
+	// Consumer side.
+	inline void discard(size_t count)
+	{
+		const size_t read { readPos.load(std::memory_order_relaxed) };
+		const size_t write { writePos.load(std::memory_order_acquire) };
+		readPos.store(read + std::min(count, write - read), std::memory_order_release);
+	}
+	inline void clear() { discard(capacity); }
+
+private:
+	inline void copyIn(size_t pos, const T* data, size_t count)
+	{
+		const size_t firstPart { std::min(count, capacity - pos) };
+		std::memcpy(&buffer[pos], data, firstPart * sizeof(T));
+		std::memcpy(&buffer[0], data + firstPart, (count - firstPart) * sizeof(T));
+	}
+	inline void copyOut(size_t pos, T* data, size_t count) const
+	{
+		const size_t firstPart { std::min(count, capacity - pos) };
+		std::memcpy(data, &buffer[pos], firstPart * sizeof(T));
+		std::memcpy(data + firstPart, &buffer[0], (count - firstPart) * sizeof(T));
+	}
+
+	std::array<T, capacity> buffer{};
+
+	alignas(64) std::atomic<size_t> writePos { 0 };
+	alignas(64) std::atomic<size_t> readPos { 0 };
+};
@@ -1,15 +1,71 @@
 #pragma once
 #include <cstdint>
+#include <cstring>
+#include <array>
+#include <bit>
+#include <span>
 #include <random>
 
 namespace RngOps
 {
-	inline std::random_device rd;
-	inline std::mt19937 gen(rd()); 
-	inline std::uniform_int_distribution<std::mt19937::result_type> dist(0, 255);
-
-	inline uint8_t gen8bit()
+	// xoshiro256** (https://prng.di.unimi.it/). Every GBCore has its own, so power-on state of an instance can be reproduced from a seed.
+	class Xoshiro256
 	{
-		return static_cast<uint8_t>(dist(gen));
-	}
-}
\ No newline at end of file
+	public:
+		Xoshiro256()
+		{
+			std::random_device rd;
+			seed(static_cast<uint64_t>(rd()) << 32 | rd());
+		}
+		explicit Xoshiro256(uint64_t value) { seed(value); }
+
+		// State is expanded from the seed with splitmix64, as recommended by the authors.
+		constexpr void seed(uint64_t value)
+		{
+			for (uint64_t& i : s)
+			{
+				value += 0x9E3779B97F4A7C15;
+				uint64_t z { value };
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+				i = z ^ (z >> 31);
+			}
+		}
+
+		constexpr uint64_t next()
+		{
+			const uint64_t result { std::rotl(s[1] * 5, 7) * 9 };
+			const uint64_t t { s[1] << 17 };
+
+			s[2] ^= s[0];
+			s[3] ^= s[1];
+			s[1] ^= s[2];
+			s[0] ^= s[3];
+			s[2] ^= t;
+			s[3] = std::rotl(s[3], 45);
+
+			return result;
+		}
+
+		// 8 random bytes per step.
+		inline void fill(std::span<uint8_t> data)
+		{
+			size_t i { 0 };
+
+			for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t))
+			{
+				const uint64_t val { next() };
+				std::memcpy(data.data() + i, &val, sizeof(val));
+			}
+
+			if (i < data.size())
+			{
+				const uint64_t val { next() };
+				std::memcpy(data.data() + i, &val, data.size() - i);
+			}
+		}
+
+	private:
+		std::array<uint64_t, 4> s{};
+	};
+}
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <miniz/miniz.h>
+#include "stateCompression.h"
+
+// LZ4 block format: a sequence is a token (4 bit literal count, 4 bit match length - 4), the literals, then a 2 byte match offset.
+// Counts of 15 continue in extra bytes, each 255 byte adding another. The last sequence only has literals.
+// Compressor is the usual greedy single probe hash table one, good enough for save states (mostly RAM, long zero runs).
+
+namespace
+{
+	constexpr size_t MIN_MATCH = 4;
+	constexpr size_t LAST_LITERALS = 5; // The format requires the last 5 bytes to be literals,
+	constexpr size_t MF_LIMIT = 12;		// and the last match to start at least 12 bytes before the end.
+	constexpr size_t MAX_OFFSET = 65535;
+	constexpr int HASH_BITS = 13;
+
+	inline uint32_t read32(const uint8_t* ptr)
+	{
+		uint32_t val;
+		std::memcpy(&val, ptr, sizeof(val));
+		return val;
+	}
+	inline uint64_t read64(const uint8_t* ptr)
+	{
+		uint64_t val;
+		std::memcpy(&val, ptr, sizeof(val));
+		return val;
+	}
+
+	inline uint32_t hashSequence(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	// Number of equal bytes at 'match' and 'ptr', stopping at 'end'. Match is always before ptr.
+	inline size_t countMatching(const uint8_t* match, const uint8_t* ptr, const uint8_t* end)
+	{
+		const uint8_t* start { ptr };
+
+		while (end - ptr >= 8)
+		{
+			const uint64_t diff { read64(match) ^ read64(ptr) };
+
+			if (diff != 0)
+				return static_cast<size_t>(ptr - start) + (std::countr_zero(diff) / 8);
+
+			match += 8;
+			ptr += 8;
+		}
+
+		while (ptr < end && *match == *ptr)
+		{
+			match++;
+			ptr++;
+		}
+
+		return static_cast<size_t>(ptr - start);
+	}
+
+	inline uint8_t* writeLength(uint8_t* out, size_t len)
+	{
+		for (; len >= 255; len -= 255)
+			*out++ = 255;
+
+		*out++ = static_cast<uint8_t>(len);
+		return out;
+	}
+
+	inline bool readLength(const uint8_t*& in, const uint8_t* inEnd, size_t& len)
+	{
+		uint8_t byte;
+
+		do
+		{
+			if (in == inEnd)
+				return false;
+
+			byte = *in++;
+			len += byte;
+		}
+		while (byte == 255);
+
+		return true;
+	}
+
+	uint8_t* writeSequence(uint8_t* out, const uint8_t* literals, size_t literalCount, size_t offset = 0, size_t matchLength = 0)
+	{
+		uint8_t& token { *out++ };
+		token = static_cast<uint8_t>(std::min<size_t>(literalCount, 15) << 4);
+
+		if (literalCount >= 15)
+			out = writeLength(out, literalCount - 15);
+
+		std::memcpy(out, literals, literalCount);
+		out += literalCount;
+
+		if (matchLength == 0)
+			return out;
+
+		*out++ = static_cast<uint8_t>(offset & 0xFF);
+		*out++ = static_cast<uint8_t>(offset >> 8);
+
+		const size_t matchCode { matchLength - MIN_MATCH };
+		token |= static_cast<uint8_t>(std::min<size_t>(matchCode, 15));
+
+		if (matchCode >= 15)
+			out = writeLength(out, matchCode - 15);
+
+		return out;
+	}
+
+	size_t lz4Compress(std::span<const uint8_t> src, uint8_t* dst)
+	{
+		const uint8_t* const base { src.data() };
+		uint8_t* out { dst };
+		size_t anchor { 0 };
+
+		if (src.size() > MF_LIMIT)
+		{
+			std::array<uint32_t, 1 << HASH_BITS> table{};
+
+			const size_t searchEnd { src.size() - MF_LIMIT };
+			const uint8_t* const matchEnd { base + src.size() - LAST_LITERALS };
+
+			// Table starts zeroed, which already points at position 0.
+			size_t pos { 1 };
+
+			while (pos < searchEnd)
+			{
+				const uint32_t sequence { read32(base + pos) };
+				uint32_t& entry { table[hashSequence(sequence)] };
+
+				size_t candidate { entry };
+				entry = static_cast<uint32_t>(pos);
+
+				if (pos - candidate > MAX_OFFSET || read32(base + candidate) != sequence)
+				{
+					pos += 1 + ((pos - anchor) >> 6); // Step gets larger the longer nothing matches, so incompressible data is skipped quickly.
+					continue;
+				}
+
+				while (pos > anchor && candidate > 0 && base[pos - 1] == base[candidate - 1])
+				{
+					pos--;
+					candidate--;
+				}
+
+				const size_t matchLength { MIN_MATCH + countMatching(base + candidate + MIN_MATCH, base + pos + MIN_MATCH, matchEnd) };
+
+				out = writeSequence(out, base + anchor, pos - anchor, pos - candidate, matchLength);
+				pos += matchLength;
+				anchor = pos;
+			}
+		}
+
+		out = writeSequence(out, base + anchor, src.size() - anchor);
+		return static_cast<size_t>(out - dst);
+	}
+
+	bool lz4Decompress(std::span<const uint8_t> src, std::span<uint8_t> dst)
+	{
+		const uint8_t* in { src.data() };
+		const uint8_t* const inEnd { src.data() + src.size() };
+
+		uint8_t* out { dst.data() };
+		uint8_t* const outEnd { dst.data() + dst.size() };
+
+		while (in < inEnd)
+		{
+			const uint8_t token { *in++ };
+			size_t literalCount { static_cast<size_t>(token >> 4) };
+
+			if (literalCount == 15 && !readLength(in, inEnd, literalCount))
+				return false;
+
+			if (literalCount > static_cast<size_t>(inEnd - in) || literalCount > static_cast<size_t>(outEnd - out))
+				return false;
+
+			std::memcpy(out, in, literalCount);
+			in += literalCount;
+			out += literalCount;
+
+			if (in == inEnd)
+				break;
+
+			if (inEnd - in < 2)
+				return false;
+
+			const size_t offset { static_cast<size_t>(in[0] | (in[1] << 8)) };
+			in += 2;
+
+			size_t matchLength { static_cast<size_t>(token & 0xF) };
+
+			if (matchLength == 15 && !readLength(in, inEnd, matchLength))
+				return false;
+
+			matchLength += MIN_MATCH;
+
+			if (offset == 0 || offset > static_cast<size_t>(out - dst.data()) || matchLength > static_cast<size_t>(outEnd - out))
+				return false;
+
+			const uint8_t* match { out - offset };
+
+			uint8_t* const matchOutEnd { out + matchLength };
+
+			// Overlapping matches repeat the last 'offset' bytes, the repeated part doubles with each copy.
+			while (out < matchOutEnd)
+			{
+				const size_t count { std::min<size_t>(out - match, matchOutEnd - out) };
+				std::memcpy(out, match, count);
+				out += count;
+			}
+		}
+
+		return out == outEnd;
+	}
+}
+
+size_t StateCompression::maxCompressedSize(size_t size, StateCodec codec)
+{
+	switch (codec)
+	{
+	case StateCodec::Deflate:
+		return mz_compressBound(static_cast<mz_ulong>(size));
+	case StateCodec::LZ4:
+		return size + size / 255 + 16;
+	default:
+		return size;
+	}
+}
+
+size_t StateCompression::compressData(std::span<const uint8_t> src, std::span<uint8_t> dst, StateCodec codec)
+{
+	if (dst.size() < maxCompressedSize(src.size(), codec))
+		return 0;
+
+	switch (codec)
+	{
+	case StateCodec::Deflate:
+	{
+		mz_ulong compressedSize { static_cast<mz_ulong>(dst.size()) };
+		const int status { mz_compress2(dst.data(), &compressedSize, src.data(), static_cast<mz_ulong>(src.size()), MZ_BEST_COMPRESSION) };
+		return status == MZ_OK ? compressedSize : 0;
+	}
+	case StateCodec::LZ4:
+		return lz4Compress(src, dst.data());
+	default:
+		return 0;
+	}
+}
+
+bool StateCompression::decompressData(std::span<const uint8_t> src, std::span<uint8_t> dst, StateCodec codec)
+{
+	switch (codec)
+	{
+	case StateCodec::Deflate:
+	{
+		mz_ulong uncompressedSize { static_cast<mz_ulong>(dst.size()) };
+		const int status { mz_uncompress(dst.data(), &uncompressedSize, src.data(), static_cast<mz_ulong>(src.size())) };
+		return status == MZ_OK && uncompressedSize == dst.size();
+	}
+	case StateCodec::LZ4:
+		return lz4Decompress(src, dst);
+	default:
+		return false;
+	}
+}
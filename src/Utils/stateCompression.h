@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <span>
+
+// Codec byte stored in .mbs files before each compressed block. Values 0 and 1 match the 'isCompressed' flag used before.
+enum class StateCodec : uint8_t
+{
+	None,
+	Deflate, // miniz, smaller files. For manual exports.
+	LZ4		 // LZ4 block format, several times faster to compress. For autosaves and quick saves.
+};
+
+namespace StateCompression
+{
+	// Size the destination buffer of compressData() must have.
+	size_t maxCompressedSize(size_t size, StateCodec codec);
+
+	// Returns the compressed size, or 0 if compression failed (then store the data uncompressed).
+	size_t compressData(std::span<const uint8_t> src, std::span<uint8_t> dst, StateCodec codec);
+
+	// Returns false if the data is corrupt or doesn't decompress to exactly dst.size() bytes.
+	bool decompressData(std::span<const uint8_t> src, std::span<uint8_t> dst, StateCodec codec);
+}
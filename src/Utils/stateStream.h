@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+
+// Flat binary serialization over a caller provided buffer, used for save states. No allocations or virtual calls.
+// Signatures of write/read match iostreams, so ST_WRITE/ST_READ macros work with both.
+
+class StateWriter
+{
+public:
+	// Without a buffer nothing is stored, only the size is counted.
+	StateWriter() = default;
+	explicit StateWriter(std::span<uint8_t> buffer) : buffer(buffer)
+	{}
+
+	inline void write(const char* data, size_t count)
+	{
+		if (count <= buffer.size() - std::min(pos, buffer.size()))
+			std::memcpy(buffer.data() + pos, data, count);
+		else
+			overflow = true;
+
+		pos += count;
+	}
+
+	// Bytes written, or that would have been written if the buffer was large enough.
+	inline size_t size() const { return pos; }
+	inline bool good() const { return !overflow; }
+
+	inline std::span<const uint8_t> data() const { return buffer.first(std::min(pos, buffer.size())); }
+
+private:
+	std::span<uint8_t> buffer{};
+	size_t pos { 0 };
+	bool overflow { false };
+};
+
+class StateReader
+{
+public:
+	explicit StateReader(std::span<const uint8_t> data) : buffer(data)
+	{}
+
+	// Reading past the end leaves destination untouched and marks the reader as failed.
+	inline void read(char* dest, size_t count)
+	{
+		if (count > remaining())
+		{
+			failed = true;
+			pos = buffer.size();
+			return;
+		}
+
+		std::memcpy(dest, buffer.data() + pos, count);
+		pos += count;
+	}
+
+	inline void skip(size_t count)
+	{
+		if (count > remaining())
+		{
+			failed = true;
+			count = remaining();
+		}
+
+		pos += count;
+	}
+	inline void seek(size_t newPos) { pos = std::min(newPos, buffer.size()); }
+
+	inline size_t position() const { return pos; }
+	inline size_t remaining() const { return buffer.size() - pos; }
+	inline std::span<const uint8_t> remainingData() const { return buffer.subspan(pos); }
+
+	inline bool good() const { return !failed; }
+
+private:
+	std::span<const uint8_t> buffer;
+	size_t pos { 0 };
+	bool failed { false };
+};
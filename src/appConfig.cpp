@@ -1,5 +1,6 @@
 ﻿#include "appConfig.h"
 #include <filesystem>
+#include <algorithm>
 #include <mini/ini.h>
 #include "Utils/fileUtils.h"
 #include "GBCore.h"
@@ -39,9 +40,11 @@ void appConfig::loadConfigFile()
 	file.read(config);
 
 	to_bool(batterySaves, "options", "batterySaves");
+	to_bool(incrementalBatterySaves, "options", "incrementalBatterySaves");
 	to_bool(autosaveState, "options", "autosaveState");
 	to_bool(loadLastROM, "options", "loadLastROM");
 	to_int(systemPreference, "options", "preferredSystem");
+	to_int(runAheadFrames, "options", "runAheadFrames");
 
 	if (config.has("keyBinds"))
 	{
@@ -74,7 +77,14 @@ void appConfig::loadConfigFile()
 		}
 	}
 
+	to_bool(rewindEnabled, "rewind", "enable");
+	to_int(rewindBufferSize, "rewind", "bufferSize");
+	to_int(rewindInterval, "rewind", "interval");
+	rewindBufferSize = std::clamp(rewindBufferSize, MIN_REWIND_BUFFER_SIZE, MAX_REWIND_BUFFER_SIZE);
+	rewindInterval = std::clamp(rewindInterval, MIN_REWIND_INTERVAL, MAX_REWIND_INTERVAL);
+
 	to_bool(enableAudio, "audio", "enable");
+	to_bool(audioSync, "audio", "sync");
 	to_bool(runBootROM, "bootroms", "runBootROM");
 
 #ifndef EMSCRIPTEN
@@ -99,9 +109,11 @@ void appConfig::updateConfigFile()
 #endif
 
 	config["options"]["batterySaves"] = to_string(batterySaves);
+	config["options"]["incrementalBatterySaves"] = to_string(incrementalBatterySaves);
 	config["options"]["autosaveState"] = to_string(autosaveState);
 	config["options"]["loadLastROM"] = to_string(loadLastROM);
 	config["options"]["preferredSystem"] = std::to_string(systemPreference);
+	config["options"]["runAheadFrames"] = std::to_string(runAheadFrames);
 
 	if (KeyBindManager::keyBinds != KeyBindManager::defaultKeyBinds() || config.has("keyBinds"))
 	{
@@ -123,7 +135,12 @@ void appConfig::updateConfigFile()
 			config["customPalette"]["Color " + std::to_string(i)] = PPU::CUSTOM_PALETTE[i].toHex();
 	}
 
+	config["rewind"]["enable"] = to_string(rewindEnabled);
+	config["rewind"]["bufferSize"] = std::to_string(rewindBufferSize);
+	config["rewind"]["interval"] = std::to_string(rewindInterval);
+
 	config["audio"]["enable"] = to_string(enableAudio);
+	config["audio"]["sync"] = to_string(audioSync);
 	config["bootroms"]["runBootROM"] = to_string(runBootROM);
 
 #ifndef EMSCRIPTEN
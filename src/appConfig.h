@@ -6,9 +6,11 @@ namespace appConfig
 	inline bool runBootROM { true };
 	inline bool loadLastROM { true };
 	inline int systemPreference { 0 };
+	inline int runAheadFrames { 0 };
 
 	inline bool autosaveState { true };
 	inline bool batterySaves { true };
+	inline bool incrementalBatterySaves { false }; // Write only the changed parts of .sav files, through a journal.
 
 	inline bool blending { true };
 	inline bool vsync { true };
@@ -16,7 +18,15 @@ namespace appConfig
 	inline bool bilinearFiltering { false };
 	inline bool gbcColorCorrection { false };
 
+	constexpr int MIN_REWIND_BUFFER_SIZE = 4, MAX_REWIND_BUFFER_SIZE = 256;
+	constexpr int MIN_REWIND_INTERVAL = 1, MAX_REWIND_INTERVAL = 10;
+
+	inline bool rewindEnabled { true };
+	inline int rewindBufferSize { 32 }; // In MB.
+	inline int rewindInterval { 1 }; // Frames between snapshots.
+
 	inline bool enableAudio { false };
+	inline bool audioSync { false };
 
 	inline int filter { 1 };
 	inline int palette { 0 };
@@ -0,0 +1,251 @@
+#include "audioRenderer.h"
+#include "GBCore.h"
+#include "appConfig.h"
+#include "keyBindManager.h"
+#include "APU/audioEncoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+extern GBCore gb;
+
+namespace
+{
+	// Input script lines are "<frame> <buttons>", buttons stay held from that frame until the next entry.
+	// Buttons are joined with '+' (e.g. "120 A+Start"), "none" releases everything. '#' starts a comment.
+	using InputScript = std::map<uint64_t, uint8_t>;
+
+	bool parseButtons(std::string str, uint8_t& mask)
+	{
+		std::ranges::transform(str, str.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		mask = 0;
+
+		if (str == "none")
+			return true;
+
+		std::istringstream ss { str };
+		std::string name;
+
+		while (std::getline(ss, name, '+'))
+		{
+			bool found { false };
+
+			for (int i = 0; i < 8; i++)
+			{
+				std::string keyName { KeyBindManager::getMegaBoyKeyName(static_cast<MegaBoyKey>(i)) };
+				std::ranges::transform(keyName, keyName.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+				if (name == keyName)
+				{
+					mask |= 1 << i;
+					found = true;
+					break;
+				}
+			}
+
+			if (!found)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool loadInputScript(const std::filesystem::path& path, InputScript& script)
+	{
+		std::ifstream st { path };
+
+		if (!st)
+		{
+			std::cerr << "Couldn't open input script: " << path.string() << '\n';
+			return false;
+		}
+
+		std::string line;
+		int lineNum { 0 };
+
+		while (std::getline(st, line))
+		{
+			lineNum++;
+
+			if (const auto comment = line.find('#'); comment != std::string::npos)
+				line.resize(comment);
+
+			std::istringstream ss { line };
+			uint64_t frame;
+			std::string buttons;
+
+			if (!(ss >> frame))
+			{
+				if (line.find_first_not_of(" \t\r") == std::string::npos)
+					continue;
+
+				std::cerr << "Input script line " << lineNum << ": expected frame number.\n";
+				return false;
+			}
+
+			uint8_t mask;
+
+			if (!(ss >> buttons) || !parseButtons(buttons, mask))
+			{
+				std::cerr << "Input script line " << lineNum << ": invalid buttons.\n";
+				return false;
+			}
+
+			script[frame] = mask;
+		}
+
+		return true;
+	}
+
+	std::array<std::unique_ptr<AudioEncoder>, 4> stemEncoders;
+	uint64_t stemFramesLeft { 0 };
+
+	void writeStems(const APU::ChannelSamples& samples)
+	{
+		const size_t count { static_cast<size_t>(std::min<uint64_t>(samples[0].size(), stemFramesLeft)) };
+
+		for (int i = 0; i < 4; i++)
+			stemEncoders[i]->write(samples[i].data(), count);
+
+		stemFramesLeft -= count;
+	}
+
+	void printUsage()
+	{
+		std::cerr << "Usage: MegaBoy " << AudioRenderer::CLI_FLAG << " <rom> <seconds> <output.wav|.flac> [--stems] [--input <script>]\n"
+				  << "  --stems   write each channel to its own file (<output>_ch1 ... <output>_ch4).\n";
+	}
+}
+
+int AudioRenderer::run(int argc, char* argv[])
+{
+	if (argc < 5)
+	{
+		printUsage();
+		return 1;
+	}
+
+	const std::filesystem::path romPath { argv[2] };
+	const std::filesystem::path outputPath { argv[4] };
+	double seconds;
+
+	if (!(std::istringstream { argv[3] } >> seconds) || seconds <= 0)
+	{
+		std::cerr << "Invalid duration: " << argv[3] << '\n';
+		return 1;
+	}
+
+	bool stems { false };
+	InputScript script;
+
+	for (int i = 5; i < argc; i++)
+	{
+		const std::string_view arg { argv[i] };
+
+		if (arg == "--stems")
+			stems = true;
+		else if (arg == "--input" && i + 1 < argc)
+		{
+			if (!loadInputScript(argv[++i], script))
+				return 1;
+		}
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	appConfig::loadConfigFile();
+	PPU::ColorPalette = PPU::GRAY_PALETTE.data(); // Nothing is displayed, but PPU still needs a palette.
+
+	if (!gb.loadROMFile(romPath))
+	{
+		std::cerr << "Couldn't load ROM: " << romPath.string() << '\n';
+		return 1;
+	}
+
+	gb.apu.setVolume(1.0f);
+	const uint64_t totalFrames { static_cast<uint64_t>(seconds * APU::SAMPLE_RATE) };
+
+	std::unique_ptr<AudioEncoder> mixEncoder;
+
+	if (stems)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			auto stemPath { outputPath };
+			stemPath.replace_filename(outputPath.stem().string() + "_ch" + std::to_string(i + 1) + outputPath.extension().string());
+
+			if (!(stemEncoders[i] = AudioEncoder::create(stemPath, APU::SAMPLE_RATE, 1)))
+			{
+				std::cerr << "Couldn't create " << stemPath.string() << '\n';
+				return 1;
+			}
+		}
+
+		stemFramesLeft = totalFrames;
+		gb.apu.setChannelSamplesCallback(writeStems);
+	}
+	else if (!(mixEncoder = AudioEncoder::create(outputPath, APU::SAMPLE_RATE, APU::CHANNELS)))
+	{
+		std::cerr << "Couldn't create " << outputPath.string() << '\n';
+		return 1;
+	}
+
+	std::array<int16_t, decltype(gb.apu.sampleRing)::Capacity()> buffer;
+	uint8_t heldButtons { 0 };
+
+	for (uint64_t frame = 0; ; frame++)
+	{
+		if (const auto entry = script.find(frame); entry != script.end())
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				const bool pressed { ((entry->second >> i) & 1) != 0 };
+
+				if (pressed != (((heldButtons >> i) & 1) != 0))
+					gb.joypad.setButton(static_cast<MegaBoyKey>(i), pressed);
+			}
+
+			heldButtons = entry->second;
+		}
+
+		gb.emulateFrame();
+
+		if (stems)
+		{
+			gb.apu.sampleRing.clear();
+
+			if (stemFramesLeft == 0)
+				break;
+		}
+		else
+		{
+			const size_t count { gb.apu.sampleRing.pop(buffer.data(), buffer.size()) / APU::CHANNELS };
+			const auto remaining { totalFrames - mixEncoder->framesWritten() };
+			mixEncoder->write(buffer.data(), static_cast<size_t>(std::min<uint64_t>(count, remaining)));
+
+			if (mixEncoder->framesWritten() >= totalFrames)
+				break;
+		}
+	}
+
+	gb.apu.setChannelSamplesCallback(nullptr);
+
+	if (mixEncoder)
+		mixEncoder->finish();
+
+	for (auto& encoder : stemEncoders)
+	{
+		if (encoder)
+			encoder->finish();
+	}
+
+	return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <string_view>
+
+// Headless, faster than realtime rendering of a ROM's audio to a file (or one file per channel).
+// Usage: MegaBoy --render-audio <rom> <seconds> <output.wav|.flac> [--stems] [--input <script>]
+namespace AudioRenderer
+{
+	constexpr std::string_view CLI_FLAG { "--render-audio" };
+
+	// Returns process exit code.
+	int run(int argc, char* argv[]);
+}
@@ -82,52 +82,146 @@ void debugUI::signalSaveStateChange()
     showBreakpointHitWindow = false;
 }
 
-void debugUI::refreshCurrentVRAMTab()
+void debugUI::updateVRAMTexture(uint32_t& texture, uint16_t width, uint16_t height, const uint8_t* data)
 {
-    if (!gb.executingProgram())
+    if (!texture)
+        OpenGL::createTexture(texture, width, height, data);
+    else
+        OpenGL::updateTexture(texture, width, height, data);
+}
+
+void debugUI::renderVRAMSnapshot()
+{
+    switch (vramRenderTab)
+    {
+    case VRAMTab::TileData:
+        vramSnapshot->renderTileData(tileDataFramebuffer.get(), vramRenderTileBank);
+        break;
+    case VRAMTab::TileMap9800:
+        vramSnapshot->renderTileMap(map9800Framebuffer.get(), 0x9800);
+        break;
+    case VRAMTab::TileMap9C00:
+        vramSnapshot->renderTileMap(map9C00Framebuffer.get(), 0x9C00);
+        break;
+    default:
+        break;
+    }
+
+    vramRenderState = VRAMRenderState::Done;
+}
+
+#ifndef EMSCRIPTEN
+void debugUI::vramRenderLoop()
+{
+    while (true)
+    {
+        std::unique_lock lock { vramRenderMutex };
+        vramRenderCV.wait(lock, [] { return vramRenderStop || vramRenderState == VRAMRenderState::Rendering; });
+
+        if (vramRenderStop)
+            return;
+
+        lock.unlock();
+        renderVRAMSnapshot();
+    }
+}
+#endif
+
+void debugUI::shutdown()
+{
+#ifndef EMSCRIPTEN
+    if (!vramRenderThread.joinable())
         return;
 
-    const auto updateTexture = [](uint32_t& texture, uint16_t width, uint16_t height, const uint8_t* data)
     {
-        if (!texture)
-            OpenGL::createTexture(texture, width, height, data);
-        else
-            OpenGL::updateTexture(texture, width, height, data);
-    };
+        std::lock_guard lock { vramRenderMutex };
+        vramRenderStop = true;
+    }
+
+    vramRenderCV.notify_one();
+    vramRenderThread.join();
+#endif
+}
+
+void debugUI::uploadRenderedVRAMTab()
+{
+    if (vramRenderState != VRAMRenderState::Done)
+        return;
 
-    switch (currentVramTab)
+    switch (vramRenderTab)
     {
     case VRAMTab::TileData:
-        if (!tileDataFramebuffer)
-            tileDataFramebuffer = std::make_unique<uint8_t[]>(PPU::TILEDATA_FRAMEBUFFER_SIZE);
-
-        gb.ppu->renderTileData(tileDataFramebuffer.get(), System::Current() == GBSystem::CGB ? vramTileBank : 0);
-        updateTexture(tileDataTexture, PPU::TILES_WIDTH, PPU::TILES_HEIGHT, tileDataFramebuffer.get());
+        updateVRAMTexture(tileDataTexture, PPU::TILES_WIDTH, PPU::TILES_HEIGHT, tileDataFramebuffer.get());
         break;
     case VRAMTab::TileMap9800:
-        if (!map9800Framebuffer)
-            map9800Framebuffer = std::make_unique<uint8_t[]>(PPU::TILEMAP_FRAMEBUFFER_SIZE);
-
-        gb.ppu->renderTileMap(map9800Framebuffer.get(), 0x9800);
-        updateTexture(map9800Texture, PPU::TILEMAP_WIDTH, PPU::TILEMAP_HEIGHT, map9800Framebuffer.get());
+        updateVRAMTexture(map9800Texture, PPU::TILEMAP_WIDTH, PPU::TILEMAP_HEIGHT, map9800Framebuffer.get());
         break;
     case VRAMTab::TileMap9C00:
-        if (!map9C00Framebuffer)
-            map9C00Framebuffer = std::make_unique<uint8_t[]>(PPU::TILEMAP_FRAMEBUFFER_SIZE);
-
-        gb.ppu->renderTileMap(map9C00Framebuffer.get(), 0x9C00);
-        updateTexture(map9C00Texture, PPU::TILEMAP_WIDTH, PPU::TILEMAP_HEIGHT, map9C00Framebuffer.get());
+        updateVRAMTexture(map9C00Texture, PPU::TILEMAP_WIDTH, PPU::TILEMAP_HEIGHT, map9C00Framebuffer.get());
+        break;
+    default:
         break;
-    case VRAMTab::PPUOutput:
-        updateTexture(oamTexture, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, gb.ppu->oamFramebuffer());
-        updateTexture(backgroundTexture, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, gb.ppu->bgFramebuffer());
-        updateTexture(windowTexture, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, gb.ppu->windowFramebuffer());
+    }
+
+    vramRenderState = VRAMRenderState::Idle;
+}
+
+void debugUI::refreshCurrentVRAMTab()
+{
+    if (!gb.executingProgram())
+        return;
+
+    if (currentVramTab == VRAMTab::PPUOutput)
+    {
+        updateVRAMTexture(oamTexture, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, gb.ppu->oamFramebuffer());
+        updateVRAMTexture(backgroundTexture, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, gb.ppu->bgFramebuffer());
+        updateVRAMTexture(windowTexture, PPU::SCR_WIDTH, PPU::SCR_HEIGHT, gb.ppu->windowFramebuffer());
 
         clearBuffer(gb.ppu->oamFramebuffer());
         clearBuffer(gb.ppu->bgFramebuffer());
         clearBuffer(gb.ppu->windowFramebuffer());
-        break;
+        return;
     }
+
+    uploadRenderedVRAMTab();
+
+    // If render thread is still busy with the previous snapshot, just skip this one.
+    if (vramRenderState != VRAMRenderState::Idle)
+        return;
+
+    if (!tileDataFramebuffer)
+    {
+        tileDataFramebuffer = std::make_unique<uint8_t[]>(PPU::TILEDATA_FRAMEBUFFER_SIZE);
+        map9800Framebuffer = std::make_unique<uint8_t[]>(PPU::TILEMAP_FRAMEBUFFER_SIZE);
+        map9C00Framebuffer = std::make_unique<uint8_t[]>(PPU::TILEMAP_FRAMEBUFFER_SIZE);
+#ifndef EMSCRIPTEN
+        vramRenderThread = std::thread(vramRenderLoop);
+#endif
+    }
+
+    if (!vramSnapshot || vramSnapshotSystem != System::Current())
+    {
+        vramSnapshot = gb.ppu->createDebugSnapshot();
+        vramSnapshotSystem = System::Current();
+    }
+    else
+        gb.ppu->updateDebugSnapshot(*vramSnapshot);
+
+    vramRenderTab = currentVramTab;
+    vramRenderTileBank = System::Current() == GBSystem::CGB ? vramTileBank : 0;
+
+#ifdef EMSCRIPTEN
+    // No threads in the web build.
+    renderVRAMSnapshot();
+    uploadRenderedVRAMTab();
+#else
+    {
+        std::lock_guard lock { vramRenderMutex };
+        vramRenderState = VRAMRenderState::Rendering;
+    }
+
+    vramRenderCV.notify_one();
+#endif
 }
 
 void debugUI::signalVBlank() 
@@ -1056,6 +1150,8 @@ void debugUI::renderWindows(float scaleFactor)
         static int tileMapViewScale { std::max(1, static_cast<int>(scaleFactor)) };
         static int ppuOutputScale { std::max(1, static_cast<int>(2 * scaleFactor)) };
 
+        uploadRenderedVRAMTab();
+
         if (ImGui::Begin("VRAM View", &showVRAMView, ImGuiWindowFlags_AlwaysAutoResize))
         {
             if (ImGui::BeginTabBar("vramTabBar"))
@@ -1276,10 +1372,10 @@ void debugUI::renderWindows(float scaleFactor)
             for (int i = 0; i < 4; i++)
             {
                 const auto channelStr { "Channel " + std::to_string(i + 1) };
-                bool tempFlag { gb.apu.enabledChannels[i].load() };
+                bool enabled { gb.apu.channelEnabled(i) };
 
-                if (ImGui::Checkbox(channelStr.c_str(), &tempFlag))
-                    gb.apu.enabledChannels[i].store(tempFlag);
+                if (ImGui::Checkbox(channelStr.c_str(), &enabled))
+                    gb.apu.setChannelEnabled(i, enabled);
             }
         }
 
@@ -6,6 +6,13 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#ifndef EMSCRIPTEN
+#include <thread>
+#endif
 
 class debugUI
 {
@@ -18,6 +25,9 @@ public:
 	static void signalSaveStateChange();
 	static void signalBreakpoint();
 
+	// Stops the VRAM render thread, call before exiting.
+	static void shutdown();
+
 private:
 	enum class VRAMTab 
 	{
@@ -26,6 +36,12 @@ private:
 		TileMap9C00,
 		PPUOutput
 	};
+	enum class VRAMRenderState : uint8_t
+	{
+		Idle,
+		Rendering,
+		Done
+	};
 	enum class MemView : int
 	{
 		MemSpace,
@@ -65,6 +81,20 @@ private:
 	static inline std::unique_ptr<uint8_t[]> map9C00Framebuffer;
 	static inline std::unique_ptr<uint8_t[]> tileDataFramebuffer;
 
+	// Tile data and tile maps are rendered on a separate thread from a snapshot taken at vblank.
+	static inline std::unique_ptr<PPU> vramSnapshot;
+	static inline GBSystem vramSnapshotSystem { };
+	static inline VRAMTab vramRenderTab { VRAMTab::TileData };
+	static inline int vramRenderTileBank { 0 };
+
+	static inline std::atomic<VRAMRenderState> vramRenderState { VRAMRenderState::Idle };
+	static inline std::mutex vramRenderMutex;
+	static inline std::condition_variable vramRenderCV;
+#ifndef EMSCRIPTEN
+	static inline std::thread vramRenderThread;
+	static inline bool vramRenderStop { false };
+#endif
+
 	static inline uint32_t map9800Texture {0};
 	static inline uint32_t map9C00Texture {0};
 	static inline uint32_t tileDataTexture {0};
@@ -86,6 +116,10 @@ private:
 	static inline int32_t stepOutStartSPVal { -1 };
 
 	static inline void refreshCurrentVRAMTab();
+	static inline void uploadRenderedVRAMTab();
+	static inline void updateVRAMTexture(uint32_t& texture, uint16_t width, uint16_t height, const uint8_t* data);
+	static void renderVRAMSnapshot();
+	static void vramRenderLoop();
 	static inline void disassembleRom();
 	static inline void removeTempBreakpoint();
 	static inline void extendBreakpointDisasmWindow();
@@ -0,0 +1,364 @@
+#include <chrono>
+#include "inputMovie.h"
+#include "GBCore.h"
+#include "appConfig.h"
+#include "Utils/hashOps.h"
+#include "Utils/stateCompression.h"
+
+// .mbm INPUT MOVIE FORMAT (LITTLE ENDIAN):
+// 19 byte signature, 2 byte version
+// 1 byte start point (0 - power-on, 1 - save state), 8 byte xxHash64 of the ROM
+// 4 byte RNG seed, 8 byte RTC clock time (unix time at emulated cycle 0)
+// 1 byte system preference, 1 byte run boot ROM flag, 1 byte run-ahead frames, 1 byte buttons held at start
+// 4 byte start state size (0 for power-on), 1 byte codec (StateCodec enum), 4 byte stored size, N byte start state (GBCore::captureState)
+// 8 byte frame count, 4 byte input run count, runs of: 1 byte buttons (Joypad::getButtons), 4 byte frame count
+// 4 byte state hash count, 8 byte xxHash64 of the emulator state after every HASH_INTERVAL frames
+// 8 byte xxHash64 of the emulator state after the last frame
+
+namespace
+{
+	constexpr uint32_t MAX_START_STATE_SIZE = 16 * 1024 * 1024;
+}
+
+uint64_t InputMovie::hashState(const GBCore& gb)
+{
+	const size_t size { gb.captureState({}) };
+
+	if (stateBuffer.size() < size)
+		stateBuffer.resize(size);
+
+	gb.captureState(stateBuffer);
+	return HashOps::xxHash64({ stateBuffer.data(), size });
+}
+
+bool InputMovie::matchesROM(const GBCore& gb) const
+{
+	return gb.cartridge.loaded() && gb.cartridge.rom.hash() == romHash;
+}
+
+bool InputMovie::startRecording(GBCore& gb, StartPoint start)
+{
+	if (!gb.canSaveStateNow())
+		return false;
+
+	const auto now { std::chrono::system_clock::now().time_since_epoch() };
+
+	startPoint = start;
+	romHash = gb.cartridge.rom.hash();
+	rngSeed = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+	systemPreference = appConfig::systemPreference;
+	runBootROM = appConfig::runBootROM;
+	runAheadFrames = static_cast<uint8_t>(gb.getRunAheadFrames());
+
+	// Clock continues from the current time, so the RTC doesn't jump when it's pinned.
+	const uint64_t unixTime { static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(now).count()) };
+	clockTime = start == StartPoint::PowerOn ? unixTime : unixTime - gb.cycleCount() / GBCore::CYCLES_PER_SECOND;
+
+	startState.clear();
+	inputs.clear();
+	stateHashes.clear();
+	endHash = 0;
+	desyncFrame = 0;
+
+	startButtons = gb.joypad.getButtons();
+
+	if (start == StartPoint::SaveState)
+	{
+		startState.resize(gb.captureState({}));
+		startState.resize(gb.captureState(startState));
+	}
+
+	// Recording starts the same way as playback does, so both go through the same reset or state load.
+	if (!enterStartState(gb))
+	{
+		gb.unpinClock();
+		return false;
+	}
+
+	lastFrameCount = gb.frameCount();
+	lastCycleCount = gb.cycleCount();
+	recording = true;
+	return true;
+}
+
+bool InputMovie::recordFrame(GBCore& gb)
+{
+	if (!recording)
+		return false;
+
+	// Frame counter isn't part of save states, but the cycle counter is: a loaded state makes it jump.
+	const uint64_t frameCycles { gb.cycleCount() - lastCycleCount };
+
+	if (gb.frameCount() != lastFrameCount + 1 || frameCycles < GBCore::CYCLES_PER_FRAME / 2 || frameCycles > GBCore::CYCLES_PER_FRAME * 2)
+	{
+		stopRecording(gb);
+		return false;
+	}
+
+	lastFrameCount = gb.frameCount();
+	lastCycleCount = gb.cycleCount();
+	inputs.push_back(gb.joypad.getButtons());
+
+	if (inputs.size() % HASH_INTERVAL == 0)
+		stateHashes.push_back(hashState(gb));
+
+	return true;
+}
+
+void InputMovie::stopRecording(GBCore& gb)
+{
+	if (recording)
+	{
+		if (gb.frameCount() == lastFrameCount && gb.cycleCount() == lastCycleCount)
+			endHash = hashState(gb);
+		else
+		{
+			inputs.resize(stateHashes.size() * HASH_INTERVAL);
+			endHash = stateHashes.empty() ? 0 : stateHashes.back();
+		}
+	}
+
+	recording = false;
+	gb.unpinClock();
+}
+
+bool InputMovie::enterStartState(GBCore& gb)
+{
+	if (!matchesROM(gb))
+		return false;
+
+	gb.rng.seed(rngSeed);
+	gb.setRunAheadFrames(runAheadFrames);
+	gb.pinClock(clockTime);
+
+	// Buttons held when recording started stay held over the reset or state load. Pressing them can request an interrupt,
+	// which the reset or state load then clears like it did when recording.
+	gb.joypad.setButtons(startButtons);
+
+	if (startPoint == StartPoint::PowerOn)
+	{
+		const auto prevSystemPreference { appConfig::systemPreference };
+		const auto prevRunBootROM { appConfig::runBootROM };
+
+		appConfig::systemPreference = systemPreference;
+		appConfig::runBootROM = runBootROM;
+
+		gb.resetRom(true);
+
+		appConfig::systemPreference = prevSystemPreference;
+		appConfig::runBootROM = prevRunBootROM;
+		return true;
+	}
+
+	return gb.restoreState(startState);
+}
+
+bool InputMovie::startPlayback(GBCore& gb)
+{
+	if (!enterStartState(gb))
+	{
+		gb.unpinClock();
+		return false;
+	}
+
+	playbackFrame = 0;
+	desyncFrame = 0;
+	playing = true;
+	return true;
+}
+
+bool InputMovie::playFrame(GBCore& gb)
+{
+	if (!playing || playbackFrame >= inputs.size())
+		return false;
+
+	gb.joypad.setButtons(inputs[playbackFrame]);
+	gb.emulateFrame();
+	playbackFrame++;
+
+	const size_t hashIndex { playbackFrame / HASH_INTERVAL - 1 };
+	const bool intervalHash { playbackFrame % HASH_INTERVAL == 0 && hashIndex < stateHashes.size() };
+	const bool lastFrame { playbackFrame == inputs.size() };
+
+	if (intervalHash || lastFrame)
+	{
+		const uint64_t hash { hashState(gb) };
+
+		if ((intervalHash && stateHashes[hashIndex] != hash) || (lastFrame && endHash != hash))
+		{
+			desyncFrame = playbackFrame;
+			return false;
+		}
+	}
+
+	return playbackFrame < inputs.size();
+}
+
+void InputMovie::stopPlayback(GBCore& gb)
+{
+	playing = false;
+	gb.unpinClock();
+}
+
+void InputMovie::save(std::ostream& st) const
+{
+	const auto systemPref { static_cast<uint8_t>(systemPreference) };
+	const auto startStateSize { static_cast<uint32_t>(startState.size()) };
+
+	st.write(SIGNATURE.data(), SIGNATURE.length());
+	ST_WRITE(VERSION);
+	ST_WRITE(startPoint);
+	ST_WRITE(romHash);
+	ST_WRITE(rngSeed);
+	ST_WRITE(clockTime);
+	ST_WRITE(systemPref);
+	ST_WRITE(runBootROM);
+	ST_WRITE(runAheadFrames);
+	ST_WRITE(startButtons);
+
+	std::vector<uint8_t> compressedState(StateCompression::maxCompressedSize(startState.size(), StateCodec::LZ4));
+	StateCodec codec { StateCodec::LZ4 };
+	auto storedSize { static_cast<uint32_t>(StateCompression::compressData(startState, compressedState, codec)) };
+
+	if (storedSize == 0 || storedSize >= startState.size())
+	{
+		codec = StateCodec::None;
+		storedSize = startStateSize;
+	}
+
+	ST_WRITE(startStateSize);
+	ST_WRITE(codec);
+	ST_WRITE(storedSize);
+	st.write(reinterpret_cast<const char*>(codec == StateCodec::None ? startState.data() : compressedState.data()), storedSize);
+
+	// Buttons usually stay the same for many frames, so inputs are stored as runs.
+	std::vector<std::pair<uint8_t, uint32_t>> runs;
+
+	for (const uint8_t buttons : inputs)
+	{
+		if (!runs.empty() && runs.back().first == buttons && runs.back().second != UINT32_MAX)
+			runs.back().second++;
+		else
+			runs.emplace_back(buttons, 1);
+	}
+
+	const uint64_t frames { inputs.size() };
+	const auto runCount { static_cast<uint32_t>(runs.size()) };
+	const auto hashCount { static_cast<uint32_t>(stateHashes.size()) };
+
+	ST_WRITE(frames);
+	ST_WRITE(runCount);
+
+	for (const auto& [buttons, length] : runs)
+	{
+		ST_WRITE(buttons);
+		ST_WRITE(length);
+	}
+
+	ST_WRITE(hashCount);
+	st.write(reinterpret_cast<const char*>(stateHashes.data()), stateHashes.size() * sizeof(uint64_t));
+	ST_WRITE(endHash);
+}
+
+bool InputMovie::load(std::istream& st)
+{
+	InputMovie movie;
+
+	if (!movie.read(st))
+		return false;
+
+	*this = std::move(movie);
+	return true;
+}
+bool InputMovie::read(std::istream& st)
+{
+	std::string signature(SIGNATURE.length(), 0);
+	st.read(signature.data(), signature.length());
+
+	uint16_t version { 0 };
+	ST_READ(version);
+
+	if (!st || signature != SIGNATURE || version != VERSION)
+		return false;
+
+	uint8_t systemPref { 0 };
+	uint32_t startStateSize { 0 }, storedSize { 0 };
+	StateCodec codec { StateCodec::None };
+
+	ST_READ(startPoint);
+	ST_READ(romHash);
+	ST_READ(rngSeed);
+	ST_READ(clockTime);
+	ST_READ(systemPref);
+	ST_READ(runBootROM);
+	ST_READ(runAheadFrames);
+	ST_READ(startButtons);
+	ST_READ(startStateSize);
+	ST_READ(codec);
+	ST_READ(storedSize);
+
+	systemPreference = systemPref;
+
+	if (!st || startPoint > StartPoint::SaveState || systemPref > GBSystemPreference::ForceDMG || runAheadFrames > GBCore::MAX_RUN_AHEAD_FRAMES)
+		return false;
+
+	if (codec > StateCodec::LZ4 || startStateSize > MAX_START_STATE_SIZE || storedSize > StateCompression::maxCompressedSize(startStateSize, codec))
+		return false;
+
+	if (codec == StateCodec::None && storedSize != startStateSize)
+		return false;
+
+	std::vector<uint8_t> storedState(storedSize);
+	st.read(reinterpret_cast<char*>(storedState.data()), storedSize);
+
+	if (!st)
+		return false;
+
+	if (codec == StateCodec::None)
+		startState = std::move(storedState);
+	else
+	{
+		startState.resize(startStateSize);
+
+		if (!StateCompression::decompressData(storedState, startState, codec))
+			return false;
+	}
+
+	if (startPoint == StartPoint::SaveState && startState.empty())
+		return false;
+
+	uint64_t frames { 0 };
+	uint32_t runCount { 0 };
+
+	ST_READ(frames);
+	ST_READ(runCount);
+
+	if (!st)
+		return false;
+
+	for (uint32_t i = 0; i < runCount; i++)
+	{
+		uint8_t buttons { 0 };
+		uint32_t length { 0 };
+
+		ST_READ(buttons);
+		ST_READ(length);
+
+		if (!st || length > frames - inputs.size())
+			return false;
+
+		inputs.insert(inputs.end(), length, buttons);
+	}
+
+	uint32_t hashCount { 0 };
+	ST_READ(hashCount);
+
+	if (!st || inputs.size() != frames || hashCount > frames / HASH_INTERVAL)
+		return false;
+
+	stateHashes.resize(hashCount);
+	st.read(reinterpret_cast<char*>(stateHashes.data()), hashCount * sizeof(uint64_t));
+	ST_READ(endHash);
+
+	return static_cast<bool>(st);
+}
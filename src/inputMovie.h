@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <string_view>
+#include <filesystem>
+#include <iostream>
+
+class GBCore;
+
+// Joypad input of every frame, recorded from power-on or from the current state, that plays back frame-exactly.
+// RNG seed and RTC clock are pinned for the recording and stored, and every HASH_INTERVAL frames and after the last one a hash
+// of the emulator state is stored too, so playback can tell where it stopped matching the recording.
+class InputMovie
+{
+public:
+	static constexpr uint32_t HASH_INTERVAL = 60;
+
+	enum class StartPoint : uint8_t
+	{
+		PowerOn,
+		SaveState
+	};
+
+	// Power-on resets the game with cleared battery RAM, like a full reset.
+	bool startRecording(GBCore& gb, StartPoint start);
+	// Call after every emulated frame. Returns false and stops recording if frames weren't emulated one by one (e.g. a state was loaded).
+	bool recordFrame(GBCore& gb);
+	// If the core is no longer at the last recorded frame (a reset or a state load ended the recording),
+	// frames after the last state hash are dropped, since they can't be verified.
+	void stopRecording(GBCore& gb);
+
+	// Puts the core into the movie's start state, the movie's ROM has to be loaded.
+	bool startPlayback(GBCore& gb);
+	// Emulates the next frame with its recorded input. Returns false at the end of the movie or if it desynced.
+	bool playFrame(GBCore& gb);
+	void stopPlayback(GBCore& gb);
+
+	void save(std::ostream& st) const;
+	// Leaves the movie unchanged if the file is invalid.
+	bool load(std::istream& st);
+
+	inline bool isRecording() const { return recording; }
+	inline bool isPlaying() const { return playing; }
+	inline bool desynced() const { return desyncFrame != 0; }
+
+	inline uint64_t frameCount() const { return inputs.size(); }
+	inline uint64_t currentFrame() const { return playbackFrame; }
+	// Frame after which the state hash didn't match, 0 if none.
+	inline uint64_t getDesyncFrame() const { return desyncFrame; }
+
+	// Whether the loaded ROM is the one the movie was recorded with.
+	bool matchesROM(const GBCore& gb) const;
+
+private:
+	static constexpr std::string_view SIGNATURE = "MegaBoy Input Movie";
+	static constexpr uint16_t VERSION = 2;
+
+	StartPoint startPoint { StartPoint::PowerOn };
+	uint64_t romHash { 0 };
+	uint32_t rngSeed { 0 };
+	uint64_t clockTime { 0 };
+
+	// Settings the power-on state depends on.
+	int systemPreference { 0 };
+	bool runBootROM { false };
+	uint8_t runAheadFrames { 0 };
+	uint8_t startButtons { 0 };
+
+	std::vector<uint8_t> startState;
+	std::vector<uint8_t> inputs; // Joypad::getButtons() of each frame.
+	std::vector<uint64_t> stateHashes; // After every HASH_INTERVAL frames.
+	uint64_t endHash { 0 }; // After the last frame.
+
+	bool recording { false };
+	bool playing { false };
+
+	uint64_t lastFrameCount { 0 };
+	uint64_t lastCycleCount { 0 };
+	uint64_t playbackFrame { 0 };
+	uint64_t desyncFrame { 0 };
+
+	std::vector<uint8_t> stateBuffer;
+
+	uint64_t hashState(const GBCore& gb);
+	bool read(std::istream& st);
+	bool enterStartState(GBCore& gb);
+};
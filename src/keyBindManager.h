@@ -21,14 +21,15 @@ enum class MegaBoyKey
     Screenshot = 13,
     QuickSave = 14,
     LoadQuickSave = 15,
-    SaveStateModifier = 16,
-    LoadStateModifier = 17
+    Rewind = 16,
+    SaveStateModifier = 17,
+    LoadStateModifier = 18
 };
 
 class KeyBindManager
 {
 public:
-    static constexpr int TOTAL_BINDS = 18;
+    static constexpr int TOTAL_BINDS = 19;
     static constexpr int TOTAL_KEYS = TOTAL_BINDS - 2; // 2 are modifiers
 
     static inline std::array<int, TOTAL_BINDS> defaultKeyBinds()
@@ -51,6 +52,7 @@ public:
             GLFW_KEY_T,            // Screenshot
             GLFW_KEY_Q,		       // QuikSave
             GLFW_KEY_GRAVE_ACCENT, // LoadQuickSave
+            GLFW_KEY_BACKSLASH,    // Rewind
 
             GLFW_MOD_ALT,          // SaveStateModifier
             GLFW_MOD_SHIFT         // LoadStateModifier
@@ -85,6 +87,7 @@ public:
             case MegaBoyKey::FastForward: return "Fast Forward";
             case MegaBoyKey::QuickSave: return "Quick Save";
             case MegaBoyKey::LoadQuickSave: return "Load Quick";
+            case MegaBoyKey::Rewind: return "Rewind";
             case MegaBoyKey::ScaleUp: return "Scale Up";
             case MegaBoyKey::ScaleDown: return "Scale Down";
             case MegaBoyKey::Screenshot: return "Screenshot";
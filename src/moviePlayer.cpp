@@ -0,0 +1,75 @@
+#include "moviePlayer.h"
+#include "inputMovie.h"
+#include "GBCore.h"
+#include "appConfig.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+extern GBCore gb;
+
+int MoviePlayer::run(int argc, char* argv[])
+{
+	if (argc < 4)
+	{
+		std::cerr << "Usage: MegaBoy " << CLI_FLAG << " <rom> <movie.mbm>\n";
+		return 1;
+	}
+
+	InputMovie movie;
+
+	if (std::ifstream st { argv[3], std::ios::in | std::ios::binary }; !st || !movie.load(st))
+	{
+		std::cerr << "Couldn't load movie: " << argv[3] << '\n';
+		return 1;
+	}
+
+	appConfig::loadConfigFile();
+	PPU::ColorPalette = PPU::GRAY_PALETTE.data();
+
+	if (!gb.loadROMFile(argv[2]))
+	{
+		std::cerr << "Couldn't load ROM: " << argv[2] << '\n';
+		return 1;
+	}
+
+	// Power-on movies reset battery RAM, it mustn't be backed up or written over the real battery save.
+	appConfig::batterySaves = false;
+
+	if (!movie.matchesROM(gb))
+	{
+		std::cerr << "Movie was recorded with a different ROM.\n";
+		return 1;
+	}
+
+	if (!movie.startPlayback(gb))
+	{
+		std::cerr << "Couldn't restore the movie's start state.\n";
+		return 1;
+	}
+
+	const auto start { std::chrono::steady_clock::now() };
+
+	while (movie.playFrame(gb))
+		gb.apu.sampleRing.clear();
+
+	const double seconds { std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+	movie.stopPlayback(gb);
+
+	const auto played { movie.currentFrame() };
+
+	std::printf("%llu of %llu frames in %.3f s (%.1f fps, %.3f ms/frame)\n", static_cast<unsigned long long>(played), static_cast<unsigned long long>(movie.frameCount()),
+				seconds, played / seconds, seconds * 1000.0 / std::max<uint64_t>(played, 1));
+
+	if (movie.desynced())
+	{
+		std::printf("Desync: state doesn't match the recording after frame %llu.\n", static_cast<unsigned long long>(movie.getDesyncFrame()));
+		return 2;
+	}
+
+	std::printf("No desyncs.\n");
+	return 0;
+}
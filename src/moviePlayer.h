@@ -0,0 +1,13 @@
+#pragma once
+#include <string_view>
+
+// Headless playback of an input movie at full speed, for reproducible benchmark and regression runs.
+// Usage: MegaBoy --play-movie <rom> <movie.mbm>
+// Exit code is 2 if the movie desynced (emulator state stopped matching the recording).
+namespace MoviePlayer
+{
+	constexpr std::string_view CLI_FLAG { "--play-movie" };
+
+	// Returns process exit code.
+	int run(int argc, char* argv[]);
+}
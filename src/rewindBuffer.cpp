@@ -0,0 +1,264 @@
+#include <cstring>
+#include <algorithm>
+#include "rewindBuffer.h"
+#include "GBCore.h"
+
+void RewindBuffer::setCapacity(size_t bytes)
+{
+	if (bytes == arenaSize)
+		return;
+
+	clear();
+	arena.reset(); // Allocated on first capture, so nothing is used while rewind is disabled.
+	arenaSize = bytes;
+}
+
+void RewindBuffer::setInterval(int frames)
+{
+	captureInterval = std::max(frames, 1);
+}
+
+void RewindBuffer::clear()
+{
+	entries.clear();
+	writePos = 0;
+	storedBytes = 0;
+	framesSinceCapture = 0;
+}
+
+void RewindBuffer::onFrame(const GBCore& gb)
+{
+	if (++framesSinceCapture < captureInterval || arenaSize == 0 || !gb.cartridge.loaded())
+		return;
+
+	framesSinceCapture = 0;
+
+	if (stateBuffer.empty())
+		stateBuffer.resize(gb.captureState({}));
+
+	const size_t stateSize { gb.captureState(stateBuffer) };
+
+	if (stateSize > stateBuffer.size())
+	{
+		stateBuffer.resize(stateSize);
+		gb.captureState(stateBuffer);
+	}
+
+	const std::span<const uint8_t> state { stateBuffer.data(), stateSize };
+
+	if (const Entry* keyframe { currentKeyframe(stateSize) })
+	{
+		// Deltas over half of the state size aren't worth it, store a keyframe instead.
+		deltaBuffer.resize(stateSize / 2);
+		const size_t deltaSize { encodeDelta(entryData(*keyframe), state, deltaBuffer) };
+
+		if (deltaSize != 0 && push({ deltaBuffer.data(), deltaSize }, stateSize, false))
+			return;
+	}
+
+	push(state, stateSize, true);
+}
+
+bool RewindBuffer::rewindStep(GBCore& gb)
+{
+	if (entries.empty())
+		return false;
+
+	const Entry entry { entries.back() };
+	bool restored;
+
+	if (entry.keyframe)
+		restored = gb.restoreState(entryData(entry));
+	else
+	{
+		const auto keyframe { std::find_if(entries.rbegin(), entries.rend(), [](const Entry& e) { return e.keyframe; }) };
+
+		stateBuffer.resize(std::max(stateBuffer.size(), entry.stateSize));
+		std::memcpy(stateBuffer.data(), arena.get() + keyframe->offset, entry.stateSize);
+		applyDelta(entryData(entry), { stateBuffer.data(), entry.stateSize });
+
+		restored = gb.restoreState({ stateBuffer.data(), entry.stateSize });
+	}
+
+	entries.pop_back();
+	storedBytes -= entry.size;
+	writePos = entries.empty() ? 0 : entry.offset;
+	framesSinceCapture = 0;
+
+	return restored;
+}
+
+const RewindBuffer::Entry* RewindBuffer::currentKeyframe(size_t stateSize) const
+{
+	for (int i = static_cast<int>(entries.size()) - 1, deltas = 0; i >= 0 && deltas < KEYFRAME_INTERVAL - 1; i--, deltas++)
+	{
+		if (entries[i].keyframe)
+			return entries[i].stateSize == stateSize ? &entries[i] : nullptr;
+	}
+
+	return nullptr;
+}
+
+bool RewindBuffer::push(std::span<const uint8_t> data, size_t stateSize, bool keyframe)
+{
+	if (data.size() > arenaSize)
+	{
+		clear();
+		return false;
+	}
+
+	if (!arena)
+		arena = std::make_unique_for_overwrite<uint8_t[]>(arenaSize);
+
+	// Free space always starts at writePos and goes (wrapping around) up to the oldest entry.
+	size_t offset { writePos };
+
+	if (offset + data.size() > arenaSize)
+	{
+		// Doesn't fit before the end: space left there is skipped, and the oldest entries stored in it are dropped.
+		while (!entries.empty() && entries.front().offset >= writePos)
+			evictOldestGroup();
+
+		offset = 0;
+	}
+
+	while (!entries.empty() && entries.front().offset >= offset && entries.front().offset < offset + data.size())
+		evictOldestGroup();
+
+	// The keyframe of this delta got dropped.
+	if (!keyframe && entries.empty())
+		return false;
+
+	std::memcpy(arena.get() + offset, data.data(), data.size());
+	entries.push_back({ offset, data.size(), stateSize, keyframe });
+
+	writePos = offset + data.size();
+	storedBytes += data.size();
+	return true;
+}
+
+void RewindBuffer::evictOldestGroup()
+{
+	// Deltas are useless without their keyframe, so they are dropped together.
+	do
+	{
+		storedBytes -= entries.front().size;
+		entries.pop_front();
+	}
+	while (!entries.empty() && !entries.front().keyframe);
+
+	if (entries.empty())
+		writePos = 0;
+}
+
+// Delta is a list of (unchanged byte count, changed byte count) varint pairs, each followed by the changed bytes XORed with the keyframe.
+// States are compared 8 bytes at a time, most of RAM doesn't change between frames so the scan dominates the cost.
+
+namespace
+{
+	inline uint8_t* writeVarint(uint8_t* out, size_t val)
+	{
+		while (val >= 0x80)
+		{
+			*out++ = static_cast<uint8_t>(val | 0x80);
+			val >>= 7;
+		}
+
+		*out++ = static_cast<uint8_t>(val);
+		return out;
+	}
+
+	inline size_t readVarint(const uint8_t*& in)
+	{
+		size_t val { 0 };
+		int shift { 0 };
+
+		while (*in & 0x80)
+		{
+			val |= static_cast<size_t>(*in++ & 0x7F) << shift;
+			shift += 7;
+		}
+
+		val |= static_cast<size_t>(*in++) << shift;
+		return val;
+	}
+
+	inline uint64_t loadWord(const uint8_t* ptr)
+	{
+		uint64_t val;
+		std::memcpy(&val, ptr, sizeof(val));
+		return val;
+	}
+}
+
+size_t RewindBuffer::encodeDelta(std::span<const uint8_t> keyframe, std::span<const uint8_t> state, std::span<uint8_t> out)
+{
+	constexpr size_t WORD_SIZE { sizeof(uint64_t) };
+	constexpr size_t MAX_VARINT_PAIR_SIZE { 20 };
+
+	const size_t wordsEnd { state.size() - state.size() % WORD_SIZE };
+
+	uint8_t* outPtr { out.data() };
+	const uint8_t* outEnd { out.data() + out.size() };
+
+	size_t pos { 0 }, lastEnd { 0 };
+
+	const auto emit = [&](size_t start, size_t end) -> bool
+	{
+		if (static_cast<size_t>(outEnd - outPtr) < MAX_VARINT_PAIR_SIZE + (end - start))
+			return false;
+
+		outPtr = writeVarint(outPtr, start - lastEnd);
+		outPtr = writeVarint(outPtr, end - start);
+
+		for (size_t i = start; i < end; i++)
+			*outPtr++ = keyframe[i] ^ state[i];
+
+		lastEnd = end;
+		return true;
+	};
+
+	while (pos < wordsEnd)
+	{
+		while (pos < wordsEnd && loadWord(&keyframe[pos]) == loadWord(&state[pos]))
+			pos += WORD_SIZE;
+
+		if (pos == wordsEnd)
+			break;
+
+		const size_t start { pos };
+
+		while (pos < wordsEnd && loadWord(&keyframe[pos]) != loadWord(&state[pos]))
+			pos += WORD_SIZE;
+
+		if (!emit(start, pos))
+			return 0;
+	}
+
+	if (!std::equal(state.begin() + wordsEnd, state.end(), keyframe.begin() + wordsEnd))
+	{
+		if (!emit(wordsEnd, state.size()))
+			return 0;
+	}
+
+	return static_cast<size_t>(outPtr - out.data());
+}
+
+void RewindBuffer::applyDelta(std::span<const uint8_t> delta, std::span<uint8_t> state)
+{
+	const uint8_t* in { delta.data() };
+	const uint8_t* inEnd { delta.data() + delta.size() };
+	size_t pos { 0 };
+
+	while (in < inEnd)
+	{
+		pos += readVarint(in);
+		const size_t count { readVarint(in) };
+
+		for (size_t i = 0; i < count; i++)
+			state[pos + i] ^= in[i];
+
+		in += count;
+		pos += count;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <span>
+
+class GBCore;
+
+// Recent emulator states kept in memory for rewinding. Snapshots are stored XOR delta encoded against the last keyframe
+// (runs of unchanged bytes are skipped) in a ring of fixed size, oldest ones get dropped when it's full.
+class RewindBuffer
+{
+public:
+	static constexpr int KEYFRAME_INTERVAL = 16;
+
+	void setCapacity(size_t bytes);
+	void setInterval(int frames);
+	void clear();
+
+	// Call after every emulated frame, a snapshot is captured each 'interval' frames.
+	void onFrame(const GBCore& gb);
+
+	// Restores the newest snapshot and removes it from the buffer. Returns false if there is nothing to rewind to.
+	// Snapshots are taken mid frame, so the first frame emulated after it is partially drawn over the newer one: present the second one.
+	bool rewindStep(GBCore& gb);
+
+	inline bool empty() const { return entries.empty(); }
+	inline size_t snapshotCount() const { return entries.size(); }
+	inline size_t usedBytes() const { return storedBytes; }
+	inline size_t capacity() const { return arenaSize; }
+	inline int interval() const { return captureInterval; }
+
+private:
+	struct Entry
+	{
+		size_t offset;
+		size_t size;
+		size_t stateSize;
+		bool keyframe;
+	};
+
+	// Returns the keyframe new snapshots are encoded against, or nullptr if a new keyframe should be stored.
+	const Entry* currentKeyframe(size_t stateSize) const;
+	bool push(std::span<const uint8_t> data, size_t stateSize, bool keyframe);
+	void evictOldestGroup();
+
+	inline std::span<const uint8_t> entryData(const Entry& entry) const { return { arena.get() + entry.offset, entry.size }; }
+
+	// Returns size of the encoded delta, or 0 if it doesn't fit in 'out' (then a keyframe is cheaper).
+	static size_t encodeDelta(std::span<const uint8_t> keyframe, std::span<const uint8_t> state, std::span<uint8_t> out);
+	static void applyDelta(std::span<const uint8_t> delta, std::span<uint8_t> state);
+
+	std::unique_ptr<uint8_t[]> arena;
+	size_t arenaSize { 0 };
+	size_t writePos { 0 };
+	size_t storedBytes { 0 };
+	std::deque<Entry> entries;
+
+	std::vector<uint8_t> stateBuffer;
+	std::vector<uint8_t> deltaBuffer;
+
+	int captureInterval { 1 };
+	int framesSinceCapture { 0 };
+};
@@ -0,0 +1,49 @@
+#include <mutex>
+#include <algorithm>
+#include "romImage.h"
+#include "Utils/hashOps.h"
+
+namespace
+{
+	struct SharedImage
+	{
+		std::weak_ptr<const std::vector<uint8_t>> buffer;
+		uint64_t hash;
+	};
+
+	// Cores can load ROMs from different threads.
+	std::mutex sharedImagesMutex;
+	std::vector<SharedImage> sharedImages;
+}
+
+RomImage RomImage::share(std::vector<uint8_t>&& data)
+{
+	RomImage image;
+	image.contentHash = HashOps::xxHash64(data);
+
+	std::scoped_lock lock { sharedImagesMutex };
+	std::erase_if(sharedImages, [](const SharedImage& img) { return img.buffer.expired(); });
+
+	for (const auto& img : sharedImages)
+	{
+		if (img.hash != image.contentHash)
+			continue;
+
+		// Compared in full, the hash only narrows it down.
+		if (auto buffer { img.buffer.lock() }; buffer && *buffer == data)
+		{
+			image.buffer = std::move(buffer);
+			break;
+		}
+	}
+
+	if (!image.buffer)
+	{
+		image.buffer = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+		sharedImages.push_back({ image.buffer, image.contentHash });
+	}
+
+	image.ptr = image.buffer->data();
+	image.length = static_cast<uint32_t>(image.buffer->size());
+	return image;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <span>
+
+// Read-only handle to ROM contents. Images are shared by content: every cartridge that loads the same ROM points to one copy,
+// so many cores running the same game don't each hold up to 8 MB of it.
+class RomImage
+{
+public:
+	// Returns a handle to an already loaded image with the same contents if there is one, otherwise to the passed data.
+	static RomImage share(std::vector<uint8_t>&& data);
+
+	// ROM size doesn't have to be a power of 2: banks past the end (up to the bank mask) read as 0xFF.
+	inline uint8_t operator[](uint32_t addr) const { return addr < length ? ptr[addr] : 0xFF; }
+
+	inline uint32_t size() const { return length; }
+	inline std::span<const uint8_t> bytes() const { return { ptr, length }; }
+
+	// xxHash64 of the contents.
+	inline uint64_t hash() const { return contentHash; }
+
+	// Number of cartridges which hold the image, including this one.
+	inline long useCount() const { return buffer.use_count(); }
+
+private:
+	std::shared_ptr<const std::vector<uint8_t>> buffer;
+	const uint8_t* ptr { nullptr };
+	uint32_t length { 0 };
+	uint64_t contentHash { 0 };
+};
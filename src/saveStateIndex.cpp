@@ -0,0 +1,155 @@
+#include <fstream>
+#include "saveStateIndex.h"
+#include "defines.h"
+#include "Utils/fileUtils.h"
+#include "Utils/stateCompression.h"
+
+// SLOT INDEX FORMAT (LITTLE ENDIAN):
+// 23 byte signature, 2 byte version, 1 byte entry count, then for each entry:
+	// 1 byte slot number, 8 byte state file modification time, 8 byte state file size, 8 byte state file hash
+	// 1 byte thumbnail codec (StateCodec enum), 4 byte stored thumbnail size, N byte thumbnail (THUMBNAIL_SIZE uncompressed)
+
+bool SaveStateIndex::readFileInfo(const std::filesystem::path& path, Entry& entry)
+{
+	std::error_code err;
+	const auto modifiedTime { std::filesystem::last_write_time(path, err) };
+
+	if (err)
+		return false;
+
+	const auto fileSize { std::filesystem::file_size(path, err) };
+
+	if (err)
+		return false;
+
+	entry.modifiedTime = static_cast<int64_t>(modifiedTime.time_since_epoch().count());
+	entry.fileSize = static_cast<uint64_t>(fileSize);
+	return true;
+}
+
+std::vector<uint8_t> SaveStateIndex::downscaleThumbnail(std::span<const uint8_t> framebuffer)
+{
+	std::vector<uint8_t> thumbnail(THUMBNAIL_SIZE);
+
+	if (framebuffer.size() != PPU::FRAMEBUFFER_SIZE)
+		return thumbnail;
+
+	constexpr uint32_t ROW_SIZE = PPU::SCR_WIDTH * 3;
+
+	for (uint32_t y = 0; y < THUMBNAIL_HEIGHT; y++)
+	{
+		for (uint32_t x = 0; x < THUMBNAIL_WIDTH; x++)
+		{
+			const uint8_t* src { framebuffer.data() + (y * 2) * ROW_SIZE + (x * 2) * 3 };
+			uint8_t* dest { thumbnail.data() + (y * THUMBNAIL_WIDTH + x) * 3 };
+
+			for (int c = 0; c < 3; c++)
+				dest[c] = static_cast<uint8_t>((src[c] + src[c + 3] + src[ROW_SIZE + c] + src[ROW_SIZE + c + 3] + 2) / 4);
+		}
+	}
+
+	return thumbnail;
+}
+
+void SaveStateIndex::load(const std::filesystem::path& saveStateFolder)
+{
+	folderPath = saveStateFolder;
+	entries = {};
+	dirty = false;
+
+	std::ifstream ifs { filePath(), std::ios::in | std::ios::binary };
+
+	if (!ifs)
+		return;
+
+	std::vector<uint8_t> buffer(FileUtils::remainingBytes(ifs));
+	ifs.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+
+	StateReader st { buffer };
+
+	std::string signature(SIGNATURE.length(), 0);
+	st.read(signature.data(), signature.length());
+
+	uint16_t version { 0 };
+	uint8_t count { 0 };
+	ST_READ(version);
+	ST_READ(count);
+
+	if (!st.good() || signature != SIGNATURE || version != VERSION)
+		return;
+
+	for (int i = 0; i < count; i++)
+	{
+		uint8_t slot { 0 };
+		Entry entry;
+		StateCodec codec { StateCodec::None };
+		uint32_t storedSize { 0 };
+
+		ST_READ(slot);
+		ST_READ(entry.modifiedTime);
+		ST_READ(entry.fileSize);
+		ST_READ(entry.contentHash);
+		ST_READ(codec);
+		ST_READ(storedSize);
+
+		if (!st.good() || slot >= MAX_SLOTS || storedSize > st.remaining())
+			return;
+
+		const auto storedData { st.remainingData().first(storedSize) };
+		st.skip(storedSize);
+
+		entry.thumbnail.resize(THUMBNAIL_SIZE);
+
+		// A bad entry is just left empty, its thumbnail will be read from the state file.
+		if (codec == StateCodec::None)
+		{
+			if (storedSize != THUMBNAIL_SIZE)
+				continue;
+
+			std::ranges::copy(storedData, entry.thumbnail.begin());
+		}
+		else if (!StateCompression::decompressData(storedData, entry.thumbnail, codec))
+			continue;
+
+		entries[slot] = std::move(entry);
+	}
+}
+
+void SaveStateIndex::write(std::ostream& st) const
+{
+	const auto count { static_cast<uint8_t>(std::ranges::count_if(entries, [](const Entry& entry) { return !entry.empty(); })) };
+
+	st.write(SIGNATURE.data(), SIGNATURE.length());
+	ST_WRITE(VERSION);
+	ST_WRITE(count);
+
+	std::vector<uint8_t> compressedBuffer(StateCompression::maxCompressedSize(THUMBNAIL_SIZE, StateCodec::LZ4));
+
+	for (int slot = 0; slot < MAX_SLOTS; slot++)
+	{
+		const Entry& entry { entries[slot] };
+
+		if (entry.empty())
+			continue;
+
+		const auto slotNum { static_cast<uint8_t>(slot) };
+		StateCodec codec { StateCodec::LZ4 };
+		auto storedSize { static_cast<uint32_t>(StateCompression::compressData(entry.thumbnail, compressedBuffer, codec)) };
+
+		if (storedSize == 0 || storedSize >= THUMBNAIL_SIZE)
+		{
+			codec = StateCodec::None;
+			storedSize = THUMBNAIL_SIZE;
+		}
+
+		ST_WRITE(slotNum);
+		ST_WRITE(entry.modifiedTime);
+		ST_WRITE(entry.fileSize);
+		ST_WRITE(entry.contentHash);
+		ST_WRITE(codec);
+		ST_WRITE(storedSize);
+
+		const uint8_t* storedData { codec == StateCodec::None ? entry.thumbnail.data() : compressedBuffer.data() };
+		st.write(reinterpret_cast<const char*>(storedData), storedSize);
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <span>
+#include <ostream>
+#include <filesystem>
+
+#include "PPU/PPU.h"
+
+// Per game index of the save slots, with the file info and a downscaled thumbnail of each state,
+// so the save state menu is filled from one small file instead of decoding every state.
+// Entries are only used while the state file's modification time and size still match.
+class SaveStateIndex
+{
+public:
+	static constexpr const char* FILE_NAME = "slots.idx";
+	static constexpr int MAX_SLOTS = 10;
+
+	static constexpr uint32_t THUMBNAIL_WIDTH = PPU::SCR_WIDTH / 2;
+	static constexpr uint32_t THUMBNAIL_HEIGHT = PPU::SCR_HEIGHT / 2;
+	static constexpr uint32_t THUMBNAIL_SIZE = THUMBNAIL_WIDTH * THUMBNAIL_HEIGHT * 3; // RGB888
+
+	struct Entry
+	{
+		int64_t modifiedTime { 0 }; // Of the state file, in file clock ticks.
+		uint64_t fileSize { 0 };
+		uint64_t contentHash { 0 }; // Hash from the state file header.
+		std::vector<uint8_t> thumbnail;
+
+		inline bool empty() const { return thumbnail.empty(); }
+		inline bool matchesFile(const Entry& fileInfo) const { return !empty() && modifiedTime == fileInfo.modifiedTime && fileSize == fileInfo.fileSize; }
+	};
+
+	// Fills modification time and size of the state file. Returns false if it doesn't exist.
+	static bool readFileInfo(const std::filesystem::path& path, Entry& entry);
+	// 2x2 box filter of an RGB888 framebuffer.
+	static std::vector<uint8_t> downscaleThumbnail(std::span<const uint8_t> framebuffer);
+
+	// Reads the index of the save state folder, starts empty if it's missing or corrupt.
+	void load(const std::filesystem::path& saveStateFolder);
+	void write(std::ostream& st) const;
+
+	inline const std::filesystem::path& folder() const { return folderPath; }
+	inline std::filesystem::path filePath() const { return folderPath / FILE_NAME; }
+
+	inline const Entry& get(int slot) const { return entries[slot]; }
+
+	inline void update(int slot, Entry entry)
+	{
+		entries[slot] = std::move(entry);
+		dirty = true;
+	}
+
+	// Set when entries changed since the index was last written.
+	bool dirty { false };
+
+private:
+	static constexpr std::string_view SIGNATURE = "MegaBoy Save Slot Index";
+	static constexpr uint16_t VERSION = 1;
+
+	std::filesystem::path folderPath;
+	std::array<Entry, MAX_SLOTS> entries;
+};
@@ -0,0 +1,158 @@
+#include "stateBenchmark.h"
+#include "GBCore.h"
+#include "appConfig.h"
+#include "Utils/stateCompression.h"
+#include "Utils/hashOps.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+extern GBCore gb;
+
+namespace
+{
+	constexpr int SAMPLE_INTERVAL = 60; // Frames between captured states.
+	constexpr int REPEATS = 20;
+
+	struct Sample
+	{
+		std::vector<uint8_t> state;
+		std::vector<uint8_t> thumbnail;
+	};
+
+	struct Result
+	{
+		size_t compressedSize { 0 };
+		double compressTime { 0 };
+		double decompressTime { 0 };
+		bool valid { true };
+	};
+
+	template <typename Func>
+	double measureMicroseconds(Func&& func)
+	{
+		const auto start { std::chrono::steady_clock::now() };
+
+		for (int i = 0; i < REPEATS; i++)
+			func();
+
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / REPEATS;
+	}
+
+	Result benchmark(std::span<const uint8_t> data, StateCodec codec)
+	{
+		Result result;
+		std::vector<uint8_t> compressed(StateCompression::maxCompressedSize(data.size(), codec));
+		std::vector<uint8_t> decompressed(data.size());
+
+		result.compressTime = measureMicroseconds([&] { result.compressedSize = StateCompression::compressData(data, compressed, codec); });
+
+		if (result.compressedSize == 0)
+			return { 0, 0, 0, false };
+
+		const std::span<const uint8_t> compressedData { compressed.data(), result.compressedSize };
+		result.decompressTime = measureMicroseconds([&] { result.valid &= StateCompression::decompressData(compressedData, decompressed, codec); });
+		result.valid &= std::ranges::equal(data, decompressed);
+
+		return result;
+	}
+
+	void printResults(const char* name, const std::vector<Sample>& samples, std::vector<uint8_t> Sample::* member)
+	{
+		std::printf("%s (%zu bytes, average of %zu samples):\n", name, (samples[0].*member).size(), samples.size());
+		std::printf("  %-8s %8s %14s %16s\n", "Codec", "Ratio", "Compress (us)", "Decompress (us)");
+
+		for (const auto codec : { StateCodec::Deflate, StateCodec::LZ4 })
+		{
+			Result total;
+			size_t totalSize { 0 };
+
+			for (const auto& sample : samples)
+			{
+				const auto result { benchmark(sample.*member, codec) };
+				total.compressedSize += result.compressedSize;
+				total.compressTime += result.compressTime;
+				total.decompressTime += result.decompressTime;
+				total.valid &= result.valid;
+				totalSize += (sample.*member).size();
+			}
+
+			const double count { static_cast<double>(samples.size()) };
+
+			std::printf("  %-8s %7.1f%% %14.1f %16.1f%s\n", codec == StateCodec::Deflate ? "Deflate" : "LZ4",
+						100.0 * total.compressedSize / totalSize, total.compressTime / count, total.decompressTime / count,
+						total.valid ? "" : "  (ROUNDTRIP FAILED)");
+		}
+	}
+
+	// Files are hashed whole on every save, load and thumbnail load.
+	void printHashResults(const std::vector<Sample>& samples)
+	{
+		double fnvTime { 0 }, xxHashTime { 0 };
+		uint64_t hash { 0 };
+
+		for (const auto& sample : samples)
+		{
+			fnvTime += measureMicroseconds([&] { hash += HashOps::fnv1a(sample.state); });
+			xxHashTime += measureMicroseconds([&] { hash += HashOps::xxHash64(sample.state); });
+		}
+
+		const double count { static_cast<double>(samples.size()) };
+		std::printf("Hash of GB state (us): FNV-1a %.1f, xxHash64 %.1f (checksum %016llx)\n", fnvTime / count, xxHashTime / count, static_cast<unsigned long long>(hash));
+	}
+}
+
+int StateBenchmark::run(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr << "Usage: MegaBoy " << CLI_FLAG << " <rom> [frames]\n";
+		return 1;
+	}
+
+	int frames { 600 };
+
+	if (argc > 3 && (!(std::istringstream { argv[3] } >> frames) || frames < SAMPLE_INTERVAL))
+	{
+		std::cerr << "Frame count must be at least " << SAMPLE_INTERVAL << ".\n";
+		return 1;
+	}
+
+	appConfig::loadConfigFile();
+	PPU::ColorPalette = PPU::GRAY_PALETTE.data();
+
+	if (!gb.loadROMFile(argv[2]))
+	{
+		std::cerr << "Couldn't load ROM: " << argv[2] << '\n';
+		return 1;
+	}
+
+	// States are sampled over the run, as RAM contents (and so compression) change a lot after boot.
+	std::vector<Sample> samples;
+
+	for (int frame = 1; frame <= frames; frame++)
+	{
+		gb.emulateFrame();
+
+		if (frame % SAMPLE_INTERVAL != 0)
+			continue;
+
+		Sample sample;
+		sample.state.resize(gb.captureState({}));
+		sample.state.resize(gb.captureState(sample.state));
+
+		const uint8_t* framebuffer { gb.ppu->framebufferPtr() };
+		sample.thumbnail.assign(framebuffer, framebuffer + PPU::FRAMEBUFFER_SIZE);
+
+		samples.push_back(std::move(sample));
+	}
+
+	printResults("GB state", samples, &Sample::state);
+	printResults("Thumbnail", samples, &Sample::thumbnail);
+	printHashResults(samples);
+	return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <string_view>
+
+// Measures save state compression (size and compress/decompress time per state for each codec) and hashing.
+// Usage: MegaBoy --bench-states <rom> [frames]
+namespace StateBenchmark
+{
+	constexpr std::string_view CLI_FLAG { "--bench-states" };
+
+	// Returns process exit code.
+	int run(int argc, char* argv[]);
+}